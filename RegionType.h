@@ -336,42 +336,45 @@ void RegionType<pType>::setData( const ImageType<pType>& img ){
 	//set eccentricity
 	epsilon();
 
-	//set mean, min, maxVal
+	//set mean, min, maxVal, per channel for color.  The samples are
+	//gathered so they can be reduced in one pass with 64 bit sums
+	typedef pixelTraits<pType> traits;
+	typedef typename traits::channel channel;
+	const int C = traits::color ? 3 : 1;
+	std::vector<channel> samples;
+	SampleStats stats[3];
+	typename traits::wide mean, low, high;
+	int *meanLevel = reinterpret_cast<int*>( &mean );
+	int *lowLevel = reinterpret_cast<int*>( &low );
+	int *highLevel = reinterpret_cast<int*>( &high );
+
+	samples.reserve( (long)size * C );
 	positions.reset();
-	PixelType tmp;
-	pType pixVal;
-
-	// set the values for the first element
-	bool first = true;
 
 	while(!positions.atEnd())
 	{
 		// get the next item in the list
-		tmp = positions.getNextItem();
+		PixelType tmp = positions.getNextItem();
 		
 		// get the pixel value at that location
-		pixVal = img.getPixelVal(tmp.r, tmp.c);
-
-		// if the first set min = max = mean = pixVal
-		if ( first )
-		{
-			minVal = pixVal;
-			maxVal = pixVal;
-			meanVal = meanVal + pixVal;
-			first = false;
-		}
-		else // otherwise check to see if the values are greater
-		{
-			if ( minVal > pixVal )
-				pixVal = minVal;
-			if ( maxVal < pixVal )
-				maxVal = pixVal;
-			meanVal = meanVal + pixVal;
-		}
+		pType pixVal = img.getPixelVal(tmp.r, tmp.c);
+		const channel *val = reinterpret_cast<const channel*>( &pixVal );
+
+		samples.insert( samples.end(), val, val + C );
+	}
+
+	reduceSamples( &samples[0], (long)samples.size(), C, stats );
+
+	for ( int c = 0; c < C; c++ )
+	{
+		meanLevel[c] = stats[c].intMean();
+		lowLevel[c] = stats[c].min;
+		highLevel[c] = stats[c].max;
 	}
 
-	// divide by total to obtain mean
-	meanVal = meanVal / size;
+	meanVal = traits::narrow( mean );
+	minVal = traits::narrow( low );
+	maxVal = traits::narrow( high );
 }
 
 /******************************************************************************\
@@ -0,0 +1,158 @@
+/******************************************************************************\
+ Checks that the out-of-core band operations write exactly what the whole
+ image versions give.  Random images are written to a scratch file, run
+ through the band version and compared pixel by pixel with the in memory
+ result.  Run with "make check", it exits with 1 if anything differs.
+\******************************************************************************/
+#include <cstdio>
+#include <cstdlib>
+#include "bandOps.h"
+
+using namespace std;
+
+const char IN_FILE[] = "bandCheck_in.pgm";
+const char OUT_FILE[] = "bandCheck_out.pgm";
+const char COLOR_IN_FILE[] = "bandCheck_in.ppm";
+const char COLOR_OUT_FILE[] = "bandCheck_out.ppm";
+
+// number of pixels that differ, or -1 if the sizes don't match
+template <class pType>
+long compare( const ImageType<pType>& a, const ImageType<pType>& b )
+{
+	int N, M, Q, rows, cols, levels;
+	long diff = 0;
+
+	a.getImageInfo( N, M, Q );
+	b.getImageInfo( rows, cols, levels );
+
+	if ( N != rows || M != cols )
+		return -1;
+
+	for ( int i = 0; i < N; i++ )
+		for ( int j = 0; j < M; j++ )
+			if ( !( a.getPixelVal( i, j ) == b.getPixelVal( i, j ) ) )
+				diff++;
+
+	return diff;
+}
+
+// shrinks an N x M image by s with bands of bandRows, returns true if the
+// file matches shrinkImage
+bool checkShrink( int N, int M, double s, int bandRows )
+{
+	ImageType<int> img( N, M, 255 ), whole, banded;
+
+	for ( int i = 0; i < N; i++ )
+		for ( int j = 0; j < M; j++ )
+			img.setPixelVal( i, j, rand() % 256 );
+
+	writeImage( IN_FILE, img );
+	shrinkBands<int>( IN_FILE, OUT_FILE, s, bandRows );
+	readImage( OUT_FILE, banded );
+	whole.shrinkImage( s, img );
+
+	long diff = compare( whole, banded );
+
+	if ( diff != 0 )
+		printf( "shrinkBands %dx%d by %g, bands of %d: %ld pixels differ\n",
+		    N, M, s, bandRows, diff );
+
+	return diff == 0;
+}
+
+// thresholds an N x M image at the automatic level with bands of bandRows,
+// returns true if the file matches threshold()
+bool checkThreshold( int N, int M, int bandRows )
+{
+	ImageType<int> img( N, M, 255 ), banded;
+
+	// a bright top half over a dark bottom
+	for ( int i = 0; i < N; i++ )
+		for ( int j = 0; j < M; j++ )
+			img.setPixelVal( i, j, i < N/2 ? 200 + rand() % 56 : rand() % 120 );
+
+	writeImage( IN_FILE, img );
+	thresholdBands<int>( IN_FILE, OUT_FILE, bandRows );
+	readImage( OUT_FILE, banded );
+	img.threshold();
+
+	long diff = compare( img, banded );
+
+	if ( diff != 0 )
+		printf( "thresholdBands %dx%d, bands of %d: %ld pixels differ\n",
+		    N, M, bandRows, diff );
+
+	return diff == 0;
+}
+
+// the same for a color image, whose level comes from the pixels
+bool checkColorThreshold( int N, int M, int bandRows )
+{
+	ImageType<rgb> img( N, M, 255 ), banded;
+
+	for ( int i = 0; i < N; i++ )
+		for ( int j = 0; j < M; j++ )
+			img.setPixelVal( i, j, rgb( rand() % 256, rand() % 256,
+			    rand() % 256 ) );
+
+	writeImage( COLOR_IN_FILE, img );
+	thresholdBands<rgb>( COLOR_IN_FILE, COLOR_OUT_FILE, bandRows );
+	readImage( COLOR_OUT_FILE, banded );
+	img.threshold();
+
+	long diff = compare( img, banded );
+
+	if ( diff != 0 )
+		printf( "color thresholdBands %dx%d, bands of %d: %ld pixels "
+		    "differ\n", N, M, bandRows, diff );
+
+	return diff == 0;
+}
+
+int main()
+{
+	bool ok = true;
+
+	srand( 1 );
+
+	try
+	{
+		// rows left over when s doesn't divide N are spread over the blocks
+		ok &= checkShrink( 103, 50, 4, 16 );
+		ok &= checkShrink( 101, 37, 3, 7 );
+		ok &= checkShrink( 250, 64, 7, 1 );
+		ok &= checkShrink( 5, 9, 6, 2 );
+
+		// factors that aren't whole
+		ok &= checkShrink( 97, 40, 2.5, 11 );
+		ok &= checkShrink( 60, 33, 1.3, 4 );
+		ok &= checkShrink( 20, 17, 0.75, 3 );
+
+		// powers of two that divide the size are copied from the pyramid
+		ok &= checkShrink( 128, 96, 4, 10 );
+		ok &= checkShrink( 64, 64, 8, 3 );
+
+		for ( int k = 0; k < 50; k++ )
+			ok &= checkShrink( 1 + rand() % 150, 1 + rand() % 60,
+			    1 + rand() % 9, 1 + rand() % 40 );
+
+		// 4000 x 4000 bright pixels add up past an int
+		ok &= checkThreshold( 4000, 4000, 500 );
+		ok &= checkThreshold( 77, 130, 9 );
+		ok &= checkColorThreshold( 90, 61, 7 );
+	}
+	catch ( string err )
+	{
+		printf( "%s\n", err.c_str() );
+		ok = false;
+	}
+
+	remove( IN_FILE );
+	remove( OUT_FILE );
+	remove( COLOR_IN_FILE );
+	remove( COLOR_OUT_FILE );
+
+	printf( ok ? "band checks passed\n" : "band checks FAILED\n" );
+
+	return ok ? 0 : 1;
+}
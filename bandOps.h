@@ -0,0 +1,288 @@
+/******************************************************************************\
+ Out-of-core versions of the ImageType operations that only need a few rows
+ at a time.  Each one reads a .pgm or .ppm file a band of rows at a time with
+ a BandReader, runs the ordinary ImageType operation on the band and appends
+ the result to the output file with a BandWriter, so only one band is ever in
+ memory no matter how tall the image is.
+
+ Bands carry enough overlap for erode and dilate (and the blocks of a
+ shrink) to see the rows around them, so every operation here writes exactly
+ the file that loading the whole image, running the operation and writing it
+ back would.  pType picks the pixel type the bands are held in (it must be
+ grayscale for .pgm and color for .ppm).
+\******************************************************************************/
+
+#ifndef BAND_OPS
+#define BAND_OPS
+
+#include "imageIO.h"
+
+// name : negateBands
+// input : input and output file names, rows per band
+// output : writes the negative of the input image
+template <class pType>
+void negateBands( const char[], const char[], int );
+
+// name : thresholdBands
+// input : input and output file names, rows per band and optionally the
+//         threshold value
+// output : writes the thresholded image, without a threshold value one is
+//          picked the same way ImageType::threshold() does (this reads the
+//          input twice for a grayscale image and three times for color)
+template <class pType>
+void thresholdBands( const char[], const char[], int, pType );
+template <class pType>
+void thresholdBands( const char[], const char[], int );
+
+// name : erodeBands / dilateBands
+// input : input and output file names, rows per band
+// output : writes the eroded or dilated image
+template <class pType>
+void erodeBands( const char[], const char[], int );
+template <class pType>
+void dilateBands( const char[], const char[], int );
+
+// name : shrinkBands
+// input : input and output file names, shrink factor (more than 0, it
+//         doesn't have to be whole) and rows per band
+// output : writes the image shrunk by the factor, the same as shrinkImage
+template <class pType>
+void shrinkBands( const char[], const char[], double, int );
+
+/******************************************************************************\
+ runs op on every band of the input and writes the core rows of each band,
+ overlap is the number of rows op needs to see around the core
+\******************************************************************************/
+template <class pType>
+void mapBands( const char in[], const char out[], int bandRows, int overlap,
+	void (ImageType<pType>::*op)() )
+{
+	int N, M, Q, first, count;
+	ImageType<pType> band;
+	BandReader reader( in, bandRows, overlap );
+
+	reader.getImageInfo( N, M, Q );
+
+	BandWriter writer( out, N, M, Q, reader.isColor() );
+
+	while ( reader.readBand( band, first, count ) )
+	{
+		(band.*op)();
+		writer.writeRows( band, first, count );
+	}
+
+	writer.close();
+}
+
+/******************************************************************************\
+ negation only looks at one pixel so the bands don't need any overlap
+\******************************************************************************/
+template <class pType>
+void negateBands( const char in[], const char out[], int bandRows )
+{
+	mapBands( in, out, bandRows, 0, &ImageType<pType>::negateImage );
+}
+
+/******************************************************************************\
+ erode and dilate look one row up and down, so one row of overlap is enough
+ for the core rows to come out the same as in the whole image
+\******************************************************************************/
+template <class pType>
+void erodeBands( const char in[], const char out[], int bandRows )
+{
+	mapBands( in, out, bandRows, 1, &ImageType<pType>::erode );
+}
+
+template <class pType>
+void dilateBands( const char in[], const char out[], int bandRows )
+{
+	mapBands( in, out, bandRows, 1, &ImageType<pType>::dilate );
+}
+
+/******************************************************************************\
+ thresholds every band with the value L
+\******************************************************************************/
+template <class pType>
+void thresholdBands( const char in[], const char out[], int bandRows,
+	pType L )
+{
+	int N, M, Q, first, count;
+	ImageType<pType> band;
+	BandReader reader( in, bandRows );
+
+	reader.getImageInfo( N, M, Q );
+
+	BandWriter writer( out, N, M, Q, reader.isColor() );
+
+	while ( reader.readBand( band, first, count ) )
+	{
+		band.threshold( L );
+		writer.writeRows( band, first, count );
+	}
+
+	writer.close();
+}
+
+/******************************************************************************\
+ picks the threshold the same way ImageType::threshold() does.  A grayscale
+ image is counted into one histogram a band at a time and the level comes
+ from ImageType::meanLevel, a color one (or one with too many levels for a
+ histogram) keeps the 64 bit SampleStats of each channel, one pass for the
+ mean and a second for the mean of the pixels above it.  Either way the
+ sums are exact so T is the in memory level.  The bands have no overlap so
+ every row of a band is a core row
+\******************************************************************************/
+template <class pType>
+void thresholdBands( const char in[], const char out[], int bandRows )
+{
+	typedef pixelTraits<pType> traits;
+	typedef typename traits::channel channel;
+	const int C = traits::color ? 3 : 1;
+	typename traits::wide T;
+	int *level = reinterpret_cast<int*>( &T );
+	SampleStats total[3], above[3];
+	pType avg;
+	int N, M, Q, first, count;
+	ImageType<pType> band;
+	BandReader reader( in, bandRows );
+
+	reader.getImageInfo( N, M, Q );
+
+	if ( !traits::color && Q <= MAX_HISTOGRAM_LEVELS )
+	{
+		Histogram hist;
+		bool counted = false;
+
+		// the first band sets the histogram's levels
+		while ( reader.readBand( band, first, count ) )
+		{
+			if ( counted )
+				hist.add( band );
+			else
+				hist.build( band );
+			counted = true;
+		}
+
+		thresholdBands( in, out, bandRows,
+		    traits::narrow( ImageType<pType>::meanLevel( hist, Q ) ) );
+		return;
+	}
+
+	// average of the whole image, truncated like meanColor
+	while ( reader.readBand( band, first, count ) )
+	{
+		SampleStats stats[3];
+
+		band.statistics( stats );
+		for ( int c = 0; c < C; c++ )
+			total[c].add( stats[c] );
+	}
+
+	for ( int c = 0; c < C; c++ )
+		level[c] = total[c].intMean();
+	avg = traits::narrow( T );
+
+	// average of the pixels greater than the image's average
+	reader.rewind();
+	while ( reader.readBand( band, first, count ) )
+		for ( int i = first; i < first + count; i++ )
+		{
+			const pType *row = band.getRow(i);
+
+			for ( int j = 0; j < M; j++ )
+				if ( row[j] > avg )
+				{
+					const channel *val =
+					    reinterpret_cast<const channel*>( &row[j] );
+					for ( int c = 0; c < C; c++ )
+						above[c].add( val[c] );
+				}
+		}
+
+	for ( int c = 0; c < C; c++ )
+		level[c] = above[c].intMean();
+
+	// take the value 2/5 of the way to Q from the current location
+	T = T + (Q - toInt(T)) / 2.5;
+
+	thresholdBands( in, out, bandRows, traits::narrow( T ) );
+}
+
+/******************************************************************************\
+ the blocks are spread over the whole image the way shrinkImage spreads
+ them, rowStep comes from the full N.  Each band's summed area table carries
+ on from the corner sums of the band above, so its corners are exactly those
+ of the whole image's table and areaMean is given rows of the whole image.
+ Bands overlap by a block and a row, so an output row the band can't finish
+ (its bottom edge reaches the last row of the band, where the table would
+ need the row below) is finished by the next band, which always holds its
+ top edge.  The same row sums give the same doubles, so the file is exactly
+ the one shrinkImage writes
+\******************************************************************************/
+template <class pType>
+void shrinkBands( const char in[], const char out[], double s,
+	int bandRows )
+{
+	typedef pixelTraits<pType> traits;
+	int N, M, Q, first, count;
+	bool color;
+	ImageType<pType> band, small;
+	SummedAreaTable<pType> table;
+	std::vector<long long> above;
+
+	if ( !( s > 0 ) )
+		throw (string)"Shrink factor must be more than 0!";
+
+	readImageHeader( in, N, M, Q, color );
+
+	// the same size and blocks as shrinkImage
+	int rows = max( (int)( N / s ), 1 ), cols = max( (int)( M / s ), 1 );
+	double rowStep = (double)N / rows, colStep = (double)M / cols;
+	int overlap = (int)ceil( rowStep ) + 1;
+
+	BandReader reader( in, max( bandRows, 1 ), overlap );
+	BandWriter writer( out, rows, cols, Q, reader.isColor() );
+	int done = 0;			// output rows written
+	int next = 0;			// first core row of the next band
+
+	above.assign( (long)( M+1 ) * SummedAreaTable<pType>::C, 0 );
+	small.setImageInfo( 1, cols, Q, FILL_NONE );
+
+	while ( done < rows && reader.readBand( band, first, count ) )
+	{
+		int bandN, bandM, bandQ;
+
+		// rows [top,bottom) of the image are in the band
+		band.getImageInfo( bandN, bandM, bandQ );
+		int top = next - first, bottom = top + bandN;
+		next += count;
+
+		table.build( band, top, &above[0] );
+
+		// the bottom edge has to be above the band's last row, except at
+		// the bottom of the image
+		while ( done < rows && ( bottom == N || ( done+1 )*rowStep < bottom ) )
+		{
+			pType *dst = small.getRow(0);
+
+			for ( int j = 0; j < cols; j++ )
+				dst[j] = traits::narrow( table.areaMean( done*rowStep,
+				    j*colStep, ( done+1 )*rowStep, ( j+1 )*colStep ) );
+
+			writer.writeRows( small, 0, 1 );
+			done++;
+		}
+
+		// the next band starts a block and a row above its core
+		int nextTop = max( next - overlap, 0 );
+		if ( done < rows )
+		{
+			const long long *sums = table.cornerRow( nextTop );
+			std::copy( sums, sums + above.size(), above.begin() );
+		}
+	}
+
+	writer.close();
+}
+
+#endif
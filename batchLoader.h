@@ -0,0 +1,275 @@
+/******************************************************************************\
+ BatchLoader walks through a whole set of .pgm or .ppm files one image at a
+ time.  The files are given as a directory (every .pgm file in it for the
+ grayscale pixel types, every .ppm file for the color ones) or as a glob
+ pattern like "frames/hubble*.pgm", and are visited in alphabetical order.
+
+ Every header is read when the loader is made, so the size of every image is
+ known up front.  A small pool of threads then decodes the next few images in
+ the background while the caller works on the current one, so processing a
+ long run of frames doesn't stall waiting for the disk.  At most "ahead"
+ decoded images are held at once.
+
+ A file that can't be read doesn't stop the batch, next() throws the usual
+ error string for it (or a general one if reading it failed some other way,
+ such as running out of memory) and the following call carries on with the
+ next file.  Programs using it need to be linked with -pthread.
+\******************************************************************************/
+
+#ifndef BATCH_LOADER
+#define BATCH_LOADER
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <glob.h>
+#include <sys/stat.h>
+#include "imageIO.h"
+
+template <class pType>
+class BatchLoader
+{
+public:
+	// name : BatchLoader
+	// input : a directory or glob pattern, the number of images to decode
+	//         ahead of the caller and the number of threads decoding them
+	//         (0 uses one per processor, but never more than ahead)
+	// output : finds the files, reads their headers and starts decoding
+	BatchLoader( const char[], int = 4, int = 0 );
+
+	// stops the threads, images that haven't been taken are thrown away
+	~BatchLoader();
+
+	// number of files in the batch
+	int size() const;
+
+	// name of file i
+	const char* getName( int ) const;
+
+	// sets N, M and Q of file i from its header, returns false if the
+	// header couldn't be read
+	bool getImageInfo( int, int&, int&, int& ) const;
+
+	// name : next
+	// input : an image and a string for the file name
+	// output : waits for the next image to be decoded and moves it into the
+	//          image (no pixels are copied).  Returns false once every file
+	//          has been taken, throws the error string if the file couldn't
+	//          be read
+	bool next( ImageType<pType>&, string& );
+
+private:
+	// not copyable, the threads point back at the loader
+	BatchLoader( const BatchLoader& );
+	BatchLoader& operator=( const BatchLoader& );
+
+	// a decoded image waiting to be taken
+	struct Slot
+	{
+		bool done;				// the image (or error) is ready
+		ImageType<pType> image;	// the decoded image
+		string error;			// set if the file couldn't be read
+	};
+
+	// each thread takes the next file to decode until the loader stops
+	void work();
+
+	vector<string> names;		// every file in the batch
+	vector<int> rows, cols, levels;	// header of each file, rows is -1 if
+								// the header couldn't be read
+
+	int ahead;					// number of slots
+	vector<Slot> slots;			// file i is decoded into slot i % ahead
+	int taken;					// files handed out by next()
+	int started;				// files handed to a thread
+	bool stopping;				// set by the destructor
+
+	mutex lock;					// guards everything below the names
+	condition_variable changed;	// signalled whenever a slot changes
+	vector<thread> workers;
+};
+
+/******************************************************************************\
+ a directory becomes a .pgm (or .ppm) glob inside the directory, anything
+ else is used as a glob pattern as it is.  glob sorts the matches
+ alphabetically
+\******************************************************************************/
+template <class pType>
+BatchLoader<pType>::BatchLoader( const char pattern[], int count, int threads )
+	: ahead( count < 1 ? 1 : count ), slots( ahead ), taken( 0 ),
+	  started( 0 ), stopping( false )
+{
+	string msg, spec = pattern;
+	struct stat info;
+	glob_t found;
+
+	if ( stat( pattern, &info ) == 0 && S_ISDIR( info.st_mode ) )
+	{
+		if ( spec.empty() || spec[spec.size()-1] != '/' )
+			spec += '/';
+		spec += ( pixelTraits<pType>::color ? "*.ppm" : "*.pgm" );
+	}
+
+	int result = glob( spec.c_str(), 0, NULL, &found );
+
+	if ( result != 0 && result != GLOB_NOMATCH )
+	{
+		msg = "Can't search for images: ";
+		msg += pattern;
+		throw msg;
+	}
+
+	for ( size_t i = 0; result == 0 && i < found.gl_pathc; i++ )
+		names.push_back( found.gl_pathv[i] );
+
+	globfree( &found );
+
+	// read every header now, a bad one is reported when its image is taken
+	rows.resize( names.size() );
+	cols.resize( names.size() );
+	levels.resize( names.size() );
+
+	for ( size_t i = 0; i < names.size(); i++ )
+	{
+		bool color;
+
+		try
+		{
+			readImageHeader( names[i].c_str(), rows[i], cols[i], levels[i],
+			    color );
+		}
+		catch ( ... )
+		{
+			rows[i] = -1;
+		}
+	}
+
+	for ( int i = 0; i < ahead; i++ )
+		slots[i].done = false;
+
+	if ( threads < 1 )
+		threads = thread::hardware_concurrency();
+	threads = max( 1, min( threads, min( ahead, (int)names.size() ) ) );
+
+	for ( int i = 0; i < threads && !names.empty(); i++ )
+		workers.push_back( thread( &BatchLoader<pType>::work, this ) );
+}
+
+template <class pType>
+BatchLoader<pType>::~BatchLoader()
+{
+	{
+		lock_guard<mutex> guard( lock );
+		stopping = true;
+	}
+	changed.notify_all();
+
+	for ( size_t i = 0; i < workers.size(); i++ )
+		workers[i].join();
+}
+
+template <class pType>
+int BatchLoader<pType>::size() const
+{
+	return names.size();
+}
+
+template <class pType>
+const char* BatchLoader<pType>::getName( int i ) const
+{
+	return names[i].c_str();
+}
+
+template <class pType>
+bool BatchLoader<pType>::getImageInfo( int i, int& N, int& M, int& Q ) const
+{
+	N = rows[i];
+	M = cols[i];
+	Q = levels[i];
+
+	return rows[i] >= 0;
+}
+
+/******************************************************************************\
+ a thread may start file i once the caller has taken file i-ahead, which
+ frees slot i % ahead.  The file is read without holding the lock so several
+ files can be decoded at once
+\******************************************************************************/
+template <class pType>
+void BatchLoader<pType>::work()
+{
+	unique_lock<mutex> guard( lock );
+
+	while ( true )
+	{
+		while ( !stopping && started < (int)names.size() &&
+		        started >= taken + ahead )
+			changed.wait( guard );
+
+		if ( stopping || started >= (int)names.size() )
+			return;
+
+		int index = started++;
+		Slot& slot = slots[index % ahead];
+		ImageType<pType> image;
+		string error;
+
+		guard.unlock();
+
+		try
+		{
+			readImage( names[index].c_str(), image );
+		}
+		catch ( string s )
+		{
+			error = s;
+		}
+		catch ( ... )
+		{
+			// most likely a header too big to allocate, it mustn't escape
+			// the thread
+			error = "Couldn't read " + names[index] + "!";
+		}
+
+		guard.lock();
+
+		slot.image.swap( image );
+		slot.error = error;
+		slot.done = true;
+		changed.notify_all();
+	}
+}
+
+template <class pType>
+bool BatchLoader<pType>::next( ImageType<pType>& image, string& name )
+{
+	unique_lock<mutex> guard( lock );
+	string error;
+
+	if ( taken >= (int)names.size() )
+		return false;
+
+	Slot& slot = slots[taken % ahead];
+
+	while ( !slot.done )
+		changed.wait( guard );
+
+	// hand the decoded image over and free the slot for the threads
+	image = std::move( slot.image );
+	error = slot.error;
+	name = names[taken];
+	slot.done = false;
+	taken++;
+
+	guard.unlock();
+	changed.notify_all();
+
+	if ( !error.empty() )
+		throw error;
+
+	return true;
+}
+
+#endif
@@ -1,4 +1,5 @@
 #include <iostream>
+#include <string>
 #include "cubicSpline.h"
 
 /******************************************************************************\
@@ -6,13 +7,9 @@
 \******************************************************************************/
 cubicSpline::cubicSpline()
 {
-	// initialize all values to zero or NULL
-	for ( int i = 0; i < 3; i++ )
-	{	
-		a[i] = NULL;
-		y[i] = NULL;
-	}
+	// nothing is allocated until the first spline is created
 	len = 0;
+	channels = 0;
 }
 
 /******************************************************************************\
@@ -21,13 +18,8 @@ cubicSpline::cubicSpline()
 \******************************************************************************/
 cubicSpline::cubicSpline( int points[], int num )
 {
-	// initialize all the values to zero or NULL
-	for ( int i = 0; i < 3; i++ )
-	{	
-		a[i] = NULL;
-		y[i] = NULL;
-	}
 	len = 0;
+	channels = 0;
 	
 	// create a cubic or linear spline based on points
 	create( points, num );
@@ -39,13 +31,8 @@ cubicSpline::cubicSpline( int points[], int num )
 \******************************************************************************/
 cubicSpline::cubicSpline( rgb points[], int num )
 {
-	// initialize all the values to zero or NULL
-	for ( int i = 0; i < 3; i++ )
-	{	
-		a[i] = NULL;
-		y[i] = NULL;
-	}
 	len = 0;
+	channels = 0;
 	
 	// create a cubic
 	create( points, num );
@@ -53,78 +40,64 @@ cubicSpline::cubicSpline( rgb points[], int num )
 
 
 /******************************************************************************\
- destructor makes sure all the memory is de-allocated before object is lost
+ destructor, the vectors free themselves
 \******************************************************************************/
 cubicSpline::~cubicSpline()
 {
-	for ( int i = 0; i < 3; i++ )
-	{
-		if ( a[i] != NULL )
-			delete [] a[i];
-		if ( y[i] != NULL )
-			delete [] y[i];
-	}
 }
 
-/*****************************************************************************\
- creates a CUBIC spline function for the given points, note that an equal
- distance between nodes is assumed, since this function is being used only
- for images this should be fine since pixels are evenly spaced
-
- NOTE: This creates a natural cubic spline
-\*****************************************************************************/
-void cubicSpline::create( int points[], int num )
+/******************************************************************************\
+ the system only depends on the number of points, with a step of h every
+ row is h, 4h, h.  It is set up when the number of points or channels
+ changes and kept for the next spline
+\******************************************************************************/
+void cubicSpline::prepare( int num, int chans )
 {
+	if ( len == num-2 && channels == chans )
+		return;
+
 	// defines the step size
 	double h = 100.0 / (num-1);
 
-	// allocate memory for the variables if required
-	if ( len != num-2 )
-	{
-		len = num-2;
-		if ( a != NULL )
-			delete [] a[0];
-		if ( y != NULL )
-			delete [] y[0];
-
-		a[0] = new double[num];
-		y[0] = new double[num];
-	}
-		
-	// the vectors that will be used to calculate the tri-diagonal matrix
-	double *diag_b = new double[len];
-	double *diag_d = new double[len];
-	double *diag_a = new double[len];
-	double *B = new double[len];
+	len = num-2;
+	channels = chans;
+
+	a.assign( num*channels, 0 );
+	y.assign( num*channels, 0 );
+	B.resize( len > 0 ? len*channels : 0 );
+	work.resize( len > 0 ? 2*len : 0 );
 
 	// set up the vectors based on the Lagrange spline method
-	for ( int i = 0; i < len; i++ )
-	{
-		diag_b[i] = h;
-		diag_d[i] = 4*h;
-		diag_a[i] = h;
-		B[i] = 6/h*((points[i+2]-points[i+1])-(points[i+1]-points[i]));
+	lower.assign( len > 0 ? len : 0, h );
+	diag.assign( len > 0 ? len : 0, 4*h );
+	upper.assign( len > 0 ? len : 0, h );
 
-		// y simply holds a copy of the points
-		y[0][i] = points[i];
-	}
+	factorTriDiag( &lower[0], &diag[0], &upper[0], len, &work[0] );
+}
 
-	// get the last 2 y points since the previous loop went 2 to short
-	y[0][len] = points[len];
-	y[0][len+1] = points[len+1];
+/******************************************************************************\
+ a[0] and a[len+1] stay zero like they should be (natural spline), the ones
+ in between are solved for every channel at once
+\******************************************************************************/
+void cubicSpline::solve()
+{
+	if ( len <= 0 )
+		return;
 
-	// set the begining and end of a to zero like it should be
-	a[0][0] = a[0][len+1] = 0;
-	
-	// passing a+1 to solve for a[1]->a[len] since a[0] is already defines as 0
-	solveTriDiag( diag_b, diag_d, diag_a, B, a[0]+1, len );
+	double h = 100.0 / (len+1);
 
-	// now that a has been solved these are no longer required
-	delete [] diag_a;
-	delete [] diag_b;
-	delete [] diag_d;
-	delete [] B;
+	for ( int i = 0; i < len; i++ )
+		for ( int c = 0; c < channels; c++ )
+		{
+			const double *p = &y[i*channels + c];
 
+			B[i*channels + c] = 6/h*( ( p[2*channels] - p[channels] ) -
+			    ( p[channels] - p[0] ) );
+		}
+
+	// passing a+channels to solve for a[1]->a[len] since a[0] is already 0,
+	// the system was factored by prepare
+	sweepTriDiag( &lower[0], &work[0], &B[0], &a[channels], len, channels );
 }
 
 /*****************************************************************************\
@@ -134,82 +107,36 @@ void cubicSpline::create( int points[], int num )
 
  NOTE: This creates a natural cubic spline
 \*****************************************************************************/
-void cubicSpline::create( rgb points[], int num )
+void cubicSpline::create( int points[], int num )
 {
-	// defines the step size
-	double h = 100.0 / (num-1);
+	prepare( num, 1 );
 
-	// allocate memory for the variables if required
-	if ( len != num-2 )
-	{
-		len = num-2;
-		for ( int i = 0; i < 3; i++ )
-		{
-			if ( a != NULL )
-				delete [] a[i];
-			if ( y != NULL )
-				delete [] y[i];
-			a[i] = new double[num];
-			y[i] = new double[num];
-		}
-	}
-		
-	// the vectors that will be used to calculate the tri-diagonal matrix
-	double* diag_b[3] = {new double[len], new double[len], new double[len]};
-	double* diag_d[3] = {new double[len], new double[len], new double[len]};
-	double* diag_a[3] = {new double[len], new double[len], new double[len]};
-	double* B[3] = {new double[len], new double[len], new double[len]};
+	// y simply holds a copy of the points
+	for ( int i = 0; i < num; i++ )
+		y[i] = points[i];
 
-	// set up the vectors based on the Lagrange spline method
-	for ( int j = 0; j < 3; j++ )
-		for ( int i = 0; i < len; i++ )
-		{
-			diag_b[j][i] = h;
-			diag_d[j][i] = 4*h;
-			diag_a[j][i] = h;
-			if ( j == 0 )
-			{
-				B[j][i] = 6/h*((points[i+2].r-points[i+1].r)
-				          -(points[i+1].r-points[i].r));
-				y[j][i] = points[i].r;
-			}
-			else if ( j == 1 )
-			{
-				B[j][i] = 6/h*((points[i+2].g-points[i+1].g)
-				          -(points[i+1].g-points[i].g));
-				y[j][i] = points[i].g;
-			}
-			else if ( j == 2 )
-			{
-				B[j][i] = 6/h*((points[i+2].b-points[i+1].b)
-				          -(points[i+1].b-points[i].b));
-				y[j][i] = points[i].b;
-			}
-		}
+	solve();
+}
 
-	// get the last 2 y points since the previous loop went 2 to short
-	y[0][len] = points[len].r;
-	y[1][len] = points[len].g;
-	y[2][len] = points[len].b;
+/*****************************************************************************\
+ creates a CUBIC spline function for the given points, note that an equal
+ distance between nodes is assumed, since this function is being used only
+ for images this should be fine since pixels are evenly spaced
 
-	y[0][len+1] = points[len+1].r;
-	y[1][len+1] = points[len+1].g;
-	y[2][len+1] = points[len+1].b;
+ NOTE: This creates a natural cubic spline
+\*****************************************************************************/
+void cubicSpline::create( rgb points[], int num )
+{
+	prepare( num, 3 );
 
-	// set the begining and end of a to zero like it should be
-	a[0][0] = a[0][len+1] = a[1][0] = a[1][len+1] = a[2][0] = a[2][len+1] = 0;
-	
-	// passing a+1 to solve for a[1]->a[len] since a[0] is already defines as 0
-	for ( int i = 0; i < 3; i++ )
+	for ( int i = 0; i < num; i++ )
 	{
-		solveTriDiag( diag_b[i], diag_d[i], diag_a[i], B[i], a[i]+1, len );
-	
-		// now that a has been solved these are no longer required
-		delete [] diag_a[i];
-		delete [] diag_b[i];
-		delete [] diag_d[i];
-		delete [] B[i];
+		y[i*3] = points[i].r;
+		y[i*3 + 1] = points[i].g;
+		y[i*3 + 2] = points[i].b;
 	}
+
+	solve();
 }
 
 /******************************************************************************\
@@ -219,7 +146,7 @@ void cubicSpline::create( rgb points[], int num )
 \******************************************************************************/
 void cubicSpline::getVal( double x, int& val )
 {
-	if ( len == 0 )
+	if ( len <= 0 )
 	{
 		val = 0;
 		return;
@@ -236,15 +163,16 @@ void cubicSpline::getVal( double x, int& val )
 		i = len;
 	if ( i < 0 )
 		i = 0;
+
+	// first channel of points i and i+1
+	const double *a0 = &a[i*channels], *a1 = a0 + channels;
+	const double *y0 = &y[i*channels], *y1 = y0 + channels;
 	
 	// using the definition of Lagrange cubic interpolation
-	if ( len != 0 )
-		val = (a[0][i]/(6*h)*((i+1)*h-x)*((i+1)*h-x)*((i+1)*h-x)
-			  + a[0][i+1]/(6*h)*(x-(i*h))*(x-(i*h))*(x-(i*h))
-		      + (y[0][i]/h - a[0][i]*h/6)*((i+1)*h-x)
-		      + (y[0][i+1]/h-a[0][i+1]*h/6)*(x-i*h));
-	else
-		val = 0;
+	val = (a0[0]/(6*h)*((i+1)*h-x)*((i+1)*h-x)*((i+1)*h-x)
+		  + a1[0]/(6*h)*(x-(i*h))*(x-(i*h))*(x-(i*h))
+	      + (y0[0]/h - a0[0]*h/6)*((i+1)*h-x)
+	      + (y1[0]/h-a1[0]*h/6)*(x-i*h));
 }
 
 /******************************************************************************\
@@ -254,7 +182,7 @@ void cubicSpline::getVal( double x, int& val )
 \******************************************************************************/
 void cubicSpline::getVal( double x, rgb& val )
 {
-	if ( len == 0 )
+	if ( len <= 0 || channels < 3 )
 	{
 		val.r = 0;
 		val.g = 0;
@@ -273,27 +201,122 @@ void cubicSpline::getVal( double x, rgb& val )
 		i = len;
 	if ( i < 0 )
 		i = 0;
+
+	int out[3];
+	const double *a0 = &a[i*3], *a1 = a0 + 3;
+	const double *y0 = &y[i*3], *y1 = y0 + 3;
 	
 	// using the definition of Lagrange cubic interpolation
-	if ( len != 0 )
+	for ( int c = 0; c < 3; c++ )
+		out[c] = (a0[c]/(6*h)*((i+1)*h-x)*((i+1)*h-x)*((i+1)*h-x)
+				+ a1[c]/(6*h)*(x-(i*h))*(x-(i*h))*(x-(i*h))
+				+ (y0[c]/h - a0[c]*h/6)*((i+1)*h-x)
+				+ (y1[c]/h-a1[c]*h/6)*(x-i*h));
+
+	val.r = out[0];
+	val.g = out[1];
+	val.b = out[2];
+}
+
+/******************************************************************************\
+ the terms of getVal grouped by the value they multiply, with r and l the
+ distances to the right and left ends of the interval
+   a[i]   * ( r^3/6h - r*h/6 )   +   a[i+1] * ( l^3/6h - l*h/6 )
+   y[i]   * r/h                  +   y[i+1] * l/h
+\******************************************************************************/
+splineTable::splineTable( int points, const double x[], int size )
+	: num( points ), count( size )
+{
+	int len = num - 2;
+
+	if ( num < 3 )
+		throw (std::string)"A spline needs at least 3 points!";
+
+	double h = 100.0 / ( num-1 );
+
+	knot.resize( count );
+	wa0.resize( count );
+	wa1.resize( count );
+	wy0.resize( count );
+	wy1.resize( count );
+
+	for ( int k = 0; k < count; k++ )
 	{
-		val.r = (a[0][i]/(6*h)*((i+1)*h-x)*((i+1)*h-x)*((i+1)*h-x)
-				+ a[0][i+1]/(6*h)*(x-(i*h))*(x-(i*h))*(x-(i*h))
-				+ (y[0][i]/h - a[0][i]*h/6)*((i+1)*h-x)
-				+ (y[0][i+1]/h-a[0][i+1]*h/6)*(x-i*h));
-
-		val.g = (a[1][i]/(6*h)*((i+1)*h-x)*((i+1)*h-x)*((i+1)*h-x)
-				+ a[1][i+1]/(6*h)*(x-(i*h))*(x-(i*h))*(x-(i*h))
-				+ (y[1][i]/h - a[1][i]*h/6)*((i+1)*h-x)
-				+ (y[1][i+1]/h-a[1][i+1]*h/6)*(x-i*h));
-
-		val.b = (a[2][i]/(6*h)*((i+1)*h-x)*((i+1)*h-x)*((i+1)*h-x)
-			    + a[2][i+1]/(6*h)*(x-(i*h))*(x-(i*h))*(x-(i*h))
-		        + (y[2][i]/h - a[2][i]*h/6)*((i+1)*h-x)
-		        + (y[2][i+1]/h-a[2][i+1]*h/6)*(x-i*h));
+		int i = (int)( x[k]/h );
+
+		// if x is greater than 100 or less than 0 then just use the closest
+		// curve
+		if ( i >= len+1 )
+			i = len;
+		if ( i < 0 )
+			i = 0;
+
+		double r = ( i+1 )*h - x[k];
+		double l = x[k] - i*h;
+
+		knot[k] = i;
+		wa0[k] = r*r*r / ( 6*h ) - r*h/6;
+		wa1[k] = l*l*l / ( 6*h ) - l*h/6;
+		wy0[k] = r / h;
+		wy1[k] = l / h;
+	}
+}
+
+int splineTable::size() const
+{
+	return count;
+}
+
+int splineTable::points() const
+{
+	return num;
+}
+
+/******************************************************************************\
+ evaluates every position of a table, a dot product of four weights with the
+ values around each position
+\******************************************************************************/
+void cubicSpline::getVals( const splineTable& table, int val[] ) const
+{
+	if ( table.num != len+2 || channels != 1 )
+		throw (std::string)"Spline table doesn't match the spline!";
+
+	const int *knot = &table.knot[0];
+	const double *wa0 = &table.wa0[0], *wa1 = &table.wa1[0];
+	const double *wy0 = &table.wy0[0], *wy1 = &table.wy1[0];
+
+	for ( int k = 0; k < table.count; k++ )
+	{
+		int i = knot[k];
+
+		val[k] = (int)( a[i]*wa0[k] + a[i+1]*wa1[k] + y[i]*wy0[k] +
+		    y[i+1]*wy1[k] );
+	}
+}
+
+void cubicSpline::getVals( const splineTable& table, rgb val[] ) const
+{
+	if ( table.num != len+2 || channels != 3 )
+		throw (std::string)"Spline table doesn't match the spline!";
+
+	const int *knot = &table.knot[0];
+	const double *wa0 = &table.wa0[0], *wa1 = &table.wa1[0];
+	const double *wy0 = &table.wy0[0], *wy1 = &table.wy1[0];
+
+	for ( int k = 0; k < table.count; k++ )
+	{
+		const double *a0 = &a[knot[k]*3], *a1 = a0 + 3;
+		const double *y0 = &y[knot[k]*3], *y1 = y0 + 3;
+		int out[3];
+
+		for ( int c = 0; c < 3; c++ )
+			out[c] = (int)( a0[c]*wa0[k] + a1[c]*wa1[k] + y0[c]*wy0[k] +
+			    y1[c]*wy1[k] );
+
+		val[k].r = out[0];
+		val[k].g = out[1];
+		val[k].b = out[2];
 	}
-	else
-		val.r = val.g = val.b = 0;
 }
 
 /******************************************************************************\
@@ -331,3 +354,71 @@ void solveTriDiag( double *b, double *d, double *a, double *B, double *x, int n
 		x[i] = B[i] - a[i] * x[i+1];
 }
 
+
+/******************************************************************************\
+ the same elimination as above for count systems sharing one matrix.  The
+ modified upper diagonal and the pivots only depend on the matrix so they're
+ worked out once into scratch (factorTriDiag), then every system is swept
+ with the inner loop running across the systems (sweepTriDiag)
+\******************************************************************************/
+void solveTriDiag( const double *b, const double *d, const double *a,
+	double *B, double *x, int n, int count, double *scratch )
+{
+	factorTriDiag( b, d, a, n, scratch );
+	sweepTriDiag( b, scratch, B, x, n, count );
+}
+
+void factorTriDiag( const double *b, const double *d, const double *a, int n,
+	double *scratch )
+{
+	double *upper = scratch;		// a[i] / pivot[i]
+	double *pivot = scratch + n;	// d[i] - b[i]*upper[i-1]
+
+	if ( n <= 0 )
+		return;
+
+	pivot[0] = d[0];
+	upper[0] = a[0] / pivot[0];
+	for ( int i = 1; i < n; i++ )
+	{
+		pivot[i] = d[i] - b[i]*upper[i-1];
+		upper[i] = a[i] / pivot[i];
+	}
+}
+
+void sweepTriDiag( const double *b, const double *scratch, double *B,
+	double *x, int n, int count )
+{
+	const double *upper = scratch;
+	const double *pivot = scratch + n;
+
+	if ( n <= 0 )
+		return;
+
+	// forward sweep
+	for ( int k = 0; k < count; k++ )
+		B[k] = B[k] / pivot[0];
+
+	for ( int i = 1; i < n; i++ )
+	{
+		double *cur = B + (long)i*count;
+		const double *prev = cur - count;
+
+		for ( int k = 0; k < count; k++ )
+			cur[k] = ( cur[k] - prev[k]*b[i] ) / pivot[i];
+	}
+
+	// back substitution
+	for ( int k = 0; k < count; k++ )
+		x[(long)( n-1 )*count + k] = B[(long)( n-1 )*count + k];
+
+	for ( int i = n - 2; i >= 0; i-- )
+	{
+		double *cur = x + (long)i*count;
+		const double *next = cur + count;
+		const double *rhs = B + (long)i*count;
+
+		for ( int k = 0; k < count; k++ )
+			cur[k] = rhs[k] - upper[i]*next[k];
+	}
+}
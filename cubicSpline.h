@@ -21,13 +21,54 @@
           as the linear spline must be defined before calling getVal, for
           example if you use createCubic then calling getVal will not give you
           the value of the linear spline(although getCubicVal will work).
+
+ A spline keeps its storage between calls to create, the tri-diagonal system
+ for a number of points is only set up the first time that number is used, so
+ re-using one spline object for many rows of the same length doesn't touch
+ the allocator.  The channels of an rgb spline are solved together.
+
+ When the same positions are read off many splines (every row of an image),
+ build a splineTable of them once and use getVals, each output is then four
+ multiplies instead of the whole getVal formula.
 \******************************************************************************/
 
 #ifndef CUBIC_SPL
 #define CUBIC_SPL
 
+#include <vector>
 #include "rgb.h"
 
+/******************************************************************************\
+ splineTable holds, for a list of x positions on a spline through a given
+ number of points, the interval each one falls in and the four weights that
+ combine the ends of the interval with their second derivatives.  These only
+ depend on the positions and the number of points, not on the values
+\******************************************************************************/
+class splineTable
+{
+public:
+	// name : splineTable
+	// input : number of points of the splines it'll be used with, an array
+	//         of x positions (on the same 0 to 100 scale as getVal) and its
+	//         length
+	// output : works out the interval and weights of every position
+	splineTable( int, const double[], int );
+
+	// number of positions and number of spline points it was built for
+	int size() const;
+	int points() const;
+
+private:
+	friend class cubicSpline;
+
+	int num, count;
+
+	// first point of the interval, the weights of the second derivatives at
+	// its two ends and of the values at its two ends
+	std::vector<int> knot;
+	std::vector<double> wa0, wa1, wy0, wy1;
+};
+
 class cubicSpline
 {
 public:	
@@ -48,17 +89,58 @@ public:
 	// returns the value of the linear spline
 	void getVal( double, int& );
 	void getVal( double, rgb& );
+
+	// name : getVals
+	// input : a table built for this spline's number of points, an array
+	//         with room for every position of the table
+	// output : sets the array to the spline at each position, the same as
+	//          calling getVal for each (up to rounding).  Throws a string if
+	//          the table was built for a different number of points
+	void getVals( const splineTable&, int[] ) const;
+	void getVals( const splineTable&, rgb[] ) const;
 private:
-	// holds the values used to calculate the cubic splines
-	double* a[3];
-	double* y[3];
+	// sets up the storage and the tri-diagonal system for num points of
+	// the given number of channels, if they aren't already
+	void prepare( int, int );
+
+	// solves for the second derivatives once y and B are filled in
+	void solve();
 
-	int len;	// number of sub intervals for cubic function
+	// holds the values used to calculate the cubic splines, value i of
+	// channel c is at [i*channels + c]
+	std::vector<double> a;
+	std::vector<double> y;
+
+	// the diagonals of the system (lower, main, upper), the right hand
+	// sides (laid out like a) and the factored system from factorTriDiag
+	std::vector<double> lower, diag, upper, B, work;
+
+	int len;		// number of sub intervals for cubic function
+	int channels;	// 1 for int splines, 3 for rgb
 };
 
 /* solves the matrix equation Ax=b for a tri-diagonal matrix, implementation
    for a better description, used in cubic spline function */
 void solveTriDiag( double*, double*, double*, double*, double*, int );
 
+// name : solveTriDiag (batched)
+// input : the lower, main and upper diagonals of an n x n tri-diagonal
+//         matrix, count right hand sides interleaved (value i of system k
+//         is B[i*count + k]), an array for the solutions laid out the same
+//         way, n, count and 2n doubles of scratch
+// output : x solves every system, B is overwritten and the diagonals are left
+//          alone.  The systems are swept together, the inner loops run across
+//          them so they vectorize
+void solveTriDiag( const double*, const double*, const double*, double*,
+    double*, int, int, double* );
+
+// the two halves of the batched solveTriDiag, for solving many batches with
+// the same matrix.  factorTriDiag fills the scratch from the diagonals (b, d,
+// a, n), sweepTriDiag takes the lower diagonal, that scratch, B, x, n and
+// count and solves
+void factorTriDiag( const double*, const double*, const double*, int,
+    double* );
+void sweepTriDiag( const double*, const double*, double*, double*, int, int );
+
 #endif
 
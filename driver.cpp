@@ -60,7 +60,9 @@
 #include "comp_curses.h"
 #include "imageIO.h"
 #include "image.h"
+#include "pipeline.h"
 #include "RegionType.h"
+#include "batchLoader.h"
 
 using namespace std;
 
@@ -72,7 +74,7 @@ using namespace std;
 	const char IMAGELOC[] = "./images/";
 
 	const int REGS = 5;				// values 1-9
-	const int MENU_OPTIONS = 18;	// number of main menu choices
+	const int MENU_OPTIONS = 19;	// number of main menu choices
 	const int BAD_REG = REGS;		// dont change this
 	const int NAME_LEN = 50;		// the max string length of names
 
@@ -203,6 +205,13 @@ using namespace std;
 	//				 that range of [min,max] does not include -1
 	int promptForIntValue( const char[], const char[], int, int );
 
+	// name        : promptForDoubleValue
+	// input       : title string, prompt string, min and max input value
+	// output      : the same as promptForIntValue for a double
+	// assumptions : assumes that first 2 parameters are valid c strings and
+	//				 that range of [min,max] does not include -1
+	double promptForDoubleValue( const char[], const char[], double, double );
+
 	// name        : promptForMirror
 	// input       : title string, prompt string
 	// output      : prompts user for a H, V, or C and doesn't let them cont
@@ -292,6 +301,15 @@ using namespace std;
 	template <class pType>
 	void classifyRegions( ImageType<pType>[], bool[], char[][NAME_LEN] );
 
+	// name        : countBatch
+	// input       : nothing, the user is prompted for a pattern
+	// output      : counts the regions of every image in the image folder
+	//				 that matches the pattern (all of them if it's blank) and
+	//				 shows the totals
+	// assumptions : the images are the type of the current color mode
+	template <class pType>
+	void countBatch();
+
 // Functions used for Classify/Count Regions ///////////////////////////////////
 
 	// name        : computeComponents
@@ -301,7 +319,8 @@ using namespace std;
 	// assumptions : assumes the the image is a valid image and sorted list is
 	//				 initialized
 	template <class pType>
-	int computeComponents( ImageType<pType>, sortedList<RegionType<pType> >& );
+	int computeComponents( const ImageType<pType>&,
+	    sortedList<RegionType<pType> >& );
 
 	// name        : findComponentsDFS
 	// input       : input image, output image, location of a pixel in the
@@ -313,8 +332,8 @@ using namespace std;
 	// assumptions : assumes the input is already thresholded and the location
 	//				 value is part of the region
 	template <class pType>
-	void findComponentsDFS( ImageType<pType>, ImageType<pType>&, int, int,
-	    pType, RegionType<pType>&, const ImageType<pType>& );
+	void findComponentsDFS( const ImageType<pType>&, ImageType<pType>&, int,
+	    int, pType, RegionType<pType>&, const ImageType<pType>& );
 
 	// name        : deleteSmallRegions
 	// input       : a list of regions and a threshold value
@@ -390,6 +409,7 @@ int main( int argc, char **argv )
 		"  Compute negative of an image",
 		"  Count Regions",
 		"  Classify Regions",
+		"  Count Regions in a batch",
 		"  Clear a register",
 		"  Exit" };
 
@@ -767,10 +787,13 @@ void processEntry( ImageType<pType> img[], bool loaded[], char name[][NAME_LEN],
 		case 15:	// classify regions
 			classifyRegions( img, loaded, name );
 			break;
-		case 16:	// clear register
+		case 16:	// count regions over many files
+			countBatch<pType>();
+			break;
+		case 17:	// clear register
 			clearRegister( img, loaded, name );
 			break;
-		case 17:	// exit
+		case 18:	// exit
 			// do nothing lol ^_^ maybe later add an exit screen
 			break;
 	}
@@ -809,8 +832,6 @@ void fillRegs( ImageType<pType> img[], bool loaded[], char name[][NAME_LEN],
 	int argc, char **argv )
 {
 	char *msg = new char[1+(argc-1)*40];
-	int i, j, k;
-	bool f;
 
 	// initalize string
 	msg[0] = '\0';
@@ -827,14 +848,8 @@ void fillRegs( ImageType<pType> img[], bool loaded[], char name[][NAME_LEN],
 	{
 		try
 		{
-			// read image header
-			readImageHeader( argv[index], i, j, k, f );
-
-			// set image info to header value
-			img[index-1].setImageInfo( i, j, k );
-
-			// read the rest of the image
-			readImage( argv[index], img[index-1] );
+			// map the image file, this reads the header and sizes the image
+			mapImage( argv[index], img[index-1] );
 
 			// set the name of the register to the file path
 			sprintf( name[index-1], "Register %i: %s", index, argv[index] );
@@ -884,12 +899,9 @@ void loadImage( ImageType<int> img[], bool loaded[], char name[][NAME_LEN] )
 	// the window that will hold the file menu
 	WINDOW *fileMenu;
 
-	// holds the image values N, M, and Q, the number of local image files, the
-	// index of index of the register choosen and index of the file choosen
-	int i, j, k, files, index, imageVal;
-
-	// format of file (unused for now) but required for readImageHeader param
-	bool f;
+	// holds the number of local image files, the index of the register
+	// choosen and index of the file choosen
+	int files, index, imageVal;
 
 	// get a list of local files dynamically allocated
 	files = findLocalPGM( fileNames );
@@ -937,14 +949,9 @@ void loadImage( ImageType<int> img[], bool loaded[], char name[][NAME_LEN] )
 		// if exit isn't choosen attempt to load image
 		if ( imageVal != files )
 		{
-			// read the image that was choosen
-			readImageHeader( menuChoices[imageVal], i, j, k, f );
-
-			// set up the image to store the correct data
-			img[index].setImageInfo( i, j, k );
-
-			// read and store image data
-			readImage( menuChoices[imageVal], img[index] );
+			// map the image that was choosen, this sizes the register
+			// image from the header and stores the image data
+			mapImage( menuChoices[imageVal], img[index] );
 
 			// make sure that the register is read as full
 			loaded[index] = true;
@@ -980,12 +987,9 @@ void loadImage( ImageType<rgb> img[], bool loaded[], char name[][NAME_LEN] )
 	// the window that will hold the file menu
 	WINDOW *fileMenu;
 
-	// holds the image values N, M, and Q, the number of local image files, the
-	// index of index of the register choosen and index of the file choosen
-	int i, j, k, files, index, imageVal;
-
-	// format of file (unused for now) but required for readImageHeader param
-	bool f;
+	// holds the number of local image files, the index of the register
+	// choosen and index of the file choosen
+	int files, index, imageVal;
 
 	// get a list of local files dynamically allocated
 	files = findLocalPPM( fileNames );
@@ -1032,14 +1036,9 @@ void loadImage( ImageType<rgb> img[], bool loaded[], char name[][NAME_LEN] )
 		// if exit isn't choosen attempt to load image
 		if ( imageVal != files )
 		{
-			// read the image that was choosen
-			readImageHeader( menuChoices[imageVal], i, j, k, f );
-
-			// set up the image to store the correct data
-			img[index].setImageInfo( i, j, k );
-
-			// read and store image data
-			readImage( menuChoices[imageVal], img[index] );
+			// map the image that was choosen, this sizes the register
+			// image from the header and stores the image data
+			mapImage( menuChoices[imageVal], img[index] );
 
 			// make sure that the register is read as full
 			loaded[index] = true;
@@ -1504,7 +1503,7 @@ void extractSub( ImageType<pType> img[], bool loaded[], char name[][NAME_LEN] )
 			temp.getSubImage( ULr, ULc, LRr, LRc, img[index] );
 
 			// set old image equal to subimage
-			img[index] = temp;
+			img[index].swap( temp );
 
 			// adds modified to register name
 			if ( name[index][strlen(name[index])-1] != ')' )
@@ -1553,7 +1552,7 @@ void enlargeImg( ImageType<pType> img[], bool loaded[], char name[][NAME_LEN] )
 			temp.enlargeImage( s, img[index] );
 
 			// set register image to the values of temp
-			img[index] = temp;
+			img[index].swap( temp );
 
 			// adds modified to register name
 			if ( name[index][strlen(name[index])-1] != ')' )
@@ -1571,10 +1570,11 @@ template <class pType>
 void shrinkImg( ImageType<pType> img[], bool loaded[], char name[][NAME_LEN] )
 {
 	// image info and max s value
-	int index, N, M, Q, maxS;
+	int index, N, M, Q;
+	double maxS;
 
 	// scale factor to be reduced by
-	int s;
+	double s;
 
 	// holds the reduced image before transfering it to img[index]
 	ImageType<pType> temp;
@@ -1589,20 +1589,20 @@ void shrinkImg( ImageType<pType> img[], bool loaded[], char name[][NAME_LEN] )
 		img[index].getImageInfo( N, M, Q );
 
 		// calculate maxS
-		maxS = (N > M ? N/MIN_IMG : M/MIN_IMG);
+		maxS = (N > M ? (double)N/MIN_IMG : (double)M/MIN_IMG);
 
-		// prompt for the scale value
-		s = promptForIntValue( "Shrink Image By Factor",
-				"Enter reduction factor(-1 to cancel): ", 2, maxS );
+		// prompt for the scale value, any factor works (1.5 for example)
+		s = promptForDoubleValue( "Shrink Image By Factor",
+				"Enter reduction factor(-1 to cancel): ", 1.0, maxS );
 
 		// if quit isn't choosen
-		if ( s != -1 )
+		if ( s != -1.0 )
 		{
 			// shrink the image
 			temp.shrinkImage( s, img[index] );
 
 			// store back in the register image
-			img[index] = temp;
+			img[index].swap( temp );
 
 			// adds modified to register name
 			if ( name[index][strlen(name[index])-1] != ')' )
@@ -1647,7 +1647,7 @@ void reflectImg( ImageType<pType> img[], bool loaded[], char name[][NAME_LEN] )
 				temp.reflectImage( true, img[index] );
 
 			// copy temp back to the register image
-			img[index] = temp;
+			img[index].swap( temp );
 
 			// adds modified to register name
 			if ( name[index][strlen(name[index])-1] != ')' )
@@ -1697,7 +1697,7 @@ void translateImg(ImageType<pType> img[], bool loaded[], char name[][NAME_LEN])
 			temp.translateImage( t, img[index] );
 
 			// copy back to the image register
-			img[index] = temp;
+			img[index].swap( temp );
 
 			// adds modified to register name
 			if ( name[index][strlen(name[index])-1] != ')' )
@@ -1737,7 +1737,7 @@ void rotateImg( ImageType<pType> img[], bool loaded[], char name[][NAME_LEN] )
 			temp.rotateImage( theta, img[index] );
 
 			// set image register equal to buffer temporary image
-			img[index] = temp;
+			img[index].swap( temp );
 
 			// adds modified to register name
 			if ( name[index][strlen(name[index])-1] != ')' )
@@ -1778,8 +1778,9 @@ void sumImg( ImageType<pType> img[], bool loaded[], char name[][NAME_LEN] )
 			// set temp2 equal to the second image
 			temp2 = img[index2];
 
-			// sum the images
-			img[index1] = temp1 + temp2;
+			// sum the images, the result is left in temp1
+			temp1 + temp2;
+			img[index1].swap( temp1 );
 
 			// adds modified to register name
 			if ( name[index1][strlen(name[index1])-1] != ')' )
@@ -1819,8 +1820,9 @@ void subtractImg( ImageType<pType> img[], bool loaded[], char name[][NAME_LEN] )
 			// set temp2 equal to the second image
 			temp2 = img[index2];
 
-			// subtract the images
-			img[index1] = temp1 - temp2;
+			// subtract the images, the result is left in temp1
+			temp1 - temp2;
+			img[index1].swap( temp1 );
 
 			// adds modified to register name
 			if ( name[index1][strlen(name[index1])-1] != ')' )
@@ -1881,11 +1883,8 @@ void countRegions(ImageType<pType> img[], bool loaded[], char name[][NAME_LEN])
 		// need to use Q
 		img[index].getImageInfo(N, M, Q);
 	
-		// temp image to hold labeled galaxies
-		ImageType<pType> temp(N, M, Q);
-
-		// black out image
-		temp.blackOut();
+		// temp image to hold labeled galaxies, starts out black
+		ImageType<pType> temp(N, M, Q, FILL_ZERO);
 
 		// count regions
 		count = computeComponents(img[index], regions);
@@ -1922,7 +1921,7 @@ void countRegions(ImageType<pType> img[], bool loaded[], char name[][NAME_LEN])
 		}
 
 		// set image to the counted image
-		img[index] = temp;
+		img[index].swap( temp );
 
 		// display number of regions
 		sprintf(msg, "The number of regions is %i", count);
@@ -1934,6 +1933,54 @@ void countRegions(ImageType<pType> img[], bool loaded[], char name[][NAME_LEN])
 	}
 }
 
+/******************************************************************************\
+ Count the regions of a whole run of images without loading them into the
+ registers.  The BatchLoader decodes the next few files while the current one
+ is being counted, a file that can't be read is counted as unreadable and
+ skipped
+\******************************************************************************/
+template <class pType>
+void countBatch()
+{
+	// pattern inside the image folder, the full path and the totals message
+	char pattern[NAME_LEN], path[NAME_LEN + sizeof( IMAGELOC )];
+	char msg[MSGBOX_WIDTH];
+	int images = 0, unreadable = 0;
+	long total = 0;
+
+	promptForFilename( "Count Regions in a batch", "Pattern (blank for all):",
+	    pattern );
+	sprintf( path, "%s%s", IMAGELOC, pattern );
+
+	BatchLoader<pType> batch( path );
+	ImageType<pType> image;
+	string file;
+
+	while ( true )
+	{
+		try
+		{
+			if ( !batch.next( image, file ) )
+				break;
+		}
+		catch ( string )
+		{
+			unreadable++;
+			continue;
+		}
+
+		// this will hold the list of regions
+		sortedList<RegionType<pType> > regions;
+
+		total += computeComponents( image, regions );
+		images++;
+	}
+
+	sprintf( msg, "%d images, %ld regions, %d unreadable", images, total,
+	    unreadable );
+	messageBox( "Number", msg );
+}
+
 /******************************************************************************\
  This function creates another menu which allows the user to manipulate the
  inside of an image.
@@ -1953,11 +2000,8 @@ void classifyRegions( ImageType<pType> img[], bool loaded[],
 		// obtain image dimesions
 		img[index].getImageInfo(M,N,Q);
 
-		// create an image with same dimensions as original
-		ImageType<pType> newImage(M,N,Q);
-
-		// turn image black
-		newImage.blackOut();
+		// create a black image with same dimensions as original
+		ImageType<pType> newImage(M,N,Q,FILL_ZERO);
 
 		// define list of regions
 		sortedList<RegionType<pType> > regions;
@@ -2374,6 +2418,55 @@ int promptForIntValue( const char title[], const char prompt[], int minVal,
 	return val;
 }
 
+/******************************************************************************\
+ Prompt the user for a double, the same way as promptForIntValue
+\******************************************************************************/
+double promptForDoubleValue( const char title[], const char prompt[],
+    double minVal, double maxVal )
+{
+	// message box window
+	WINDOW *pixWin;
+
+	// used in the error message
+	char msg[NAME_LEN];
+
+	// user input value
+	double val;
+
+	// draw message window
+	stdWindow( pixWin, title );
+
+	// get user input
+	val = promptForDouble( pixWin, 1, 2, prompt );
+
+	// check for valid input
+	while ( val < 0.0 && val != -1.0 )
+	{
+		// display error
+		sprintf( msg, "Please input a value (0-%.2f)", maxVal );
+		messageBox( "Invalid Value", msg );
+
+		// redraw window
+		delwin( pixWin );
+		stdWindow( pixWin, title );
+
+		// re-prompt user
+		val = promptForDouble( pixWin, 1, 2, prompt );
+	}
+
+	// clip val to be in correct range if nessessary
+	if ( val < minVal && val != -1.0 )
+		val = minVal;
+	if ( val > maxVal )
+		val = maxVal;
+
+	// delete this dynamic memory
+	delwin( pixWin );
+
+	// return value to calling function
+	return val;
+}
+
 /******************************************************************************\
  Prompt the user for the characters h, v, or c (not case sensitive) and return
  the value as soon as one of the 3 is pressed.
@@ -2841,8 +2934,8 @@ int findLocalPPM( char **&filenames )
  of regions found
 \******************************************************************************/
 template <class pType>
-int computeComponents( ImageType<pType> input, sortedList<RegionType<pType> >
-	&regions )
+int computeComponents( const ImageType<pType>& input,
+	sortedList<RegionType<pType> > &regions )
 {
 	// holds the loop values and the regions
 	int N, M, Q, count = 0;
@@ -2860,9 +2953,8 @@ int computeComponents( ImageType<pType> input, sortedList<RegionType<pType> >
 	// run threshold
 	temp.threshold();
 
-	// dilate then erode image
-	temp.dilate();
-	temp.erode();
+	// dilate then erode image, in one pass
+	ImagePipeline<pType>().dilate().erode().run( temp );
 
 	for ( int i = 0; i < N; i++ )
 		for ( int j = 0; j < M; j++ )
@@ -2882,9 +2974,9 @@ int computeComponents( ImageType<pType> input, sortedList<RegionType<pType> >
  back (uses a stack)
 \******************************************************************************/
 template <class pType>
-void findComponentsDFS(ImageType<pType> inputImg, ImageType<pType>& outputImg,
-	int startRow, int startCol, pType label, sortedList<RegionType<pType> >
-	&regions, const ImageType<pType>& original )
+void findComponentsDFS(const ImageType<pType>& inputImg,
+	ImageType<pType>& outputImg, int startRow, int startCol, pType label,
+	sortedList<RegionType<pType> > &regions, const ImageType<pType>& original )
 {
 	// used to hold limits for the loop
 	int N, M, Q;
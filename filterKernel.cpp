@@ -0,0 +1,339 @@
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <algorithm>
+#include "filterKernel.h"
+
+using namespace std;
+
+// most weight sets kept by getFilterWeights before it starts over
+static const size_t WEIGHT_CACHE = 32;
+
+/******************************************************************************\
+ the built in kernels
+\******************************************************************************/
+static double boxWeight( double x )
+{
+	return ( x >= -0.5 && x < 0.5 ) ? 1 : 0;
+}
+
+static double triangleWeight( double x )
+{
+	x = fabs( x );
+	return x < 1 ? 1 - x : 0;
+}
+
+// the Mitchell-Netravali family of cubics
+static double cubicWeight( double x, double B, double C )
+{
+	x = fabs( x );
+
+	if ( x < 1 )
+		return ( ( 12 - 9*B - 6*C )*x*x*x + ( -18 + 12*B + 6*C )*x*x +
+		    ( 6 - 2*B ) ) / 6;
+	if ( x < 2 )
+		return ( ( -B - 6*C )*x*x*x + ( 6*B + 30*C )*x*x +
+		    ( -12*B - 48*C )*x + ( 8*B + 24*C ) ) / 6;
+	return 0;
+}
+
+static double catmullRomWeight( double x )
+{
+	return cubicWeight( x, 0, 0.5 );
+}
+
+static double mitchellWeight( double x )
+{
+	return cubicWeight( x, 1.0/3, 1.0/3 );
+}
+
+static double lanczos3Weight( double x )
+{
+	// 4 * atan(1) = pi
+	const double pi = 4 * atan( 1.0 );
+
+	x = fabs( x );
+	if ( x < 1e-9 )
+		return 1;
+	if ( x >= 3 )
+		return 0;
+
+	return 3 * sin( pi*x ) * sin( pi*x/3 ) / ( pi*pi*x*x );
+}
+
+/******************************************************************************\
+ the registry, names are kept in a deque so the pointers handed out in
+ FilterKernel stay good as more kernels are added
+\******************************************************************************/
+static mutex registryLock;
+static vector<FilterKernel> kernels;
+static deque<string> kernelNames;
+
+// adds a kernel, registryLock must be held
+static int addKernel( const char name[], double support,
+	double (*weight)( double ) )
+{
+	FilterKernel k;
+
+	kernelNames.push_back( name );
+	k.name = kernelNames.back().c_str();
+	k.support = support;
+	k.weight = weight;
+	kernels.push_back( k );
+
+	return kernels.size() - 1;
+}
+
+// registryLock must be held
+static void addBuiltIns()
+{
+	if ( !kernels.empty() )
+		return;
+
+	// in the order of FilterType
+	addKernel( "box", 0.5, boxWeight );
+	addKernel( "triangle", 1, triangleWeight );
+	addKernel( "catmull-rom", 2, catmullRomWeight );
+	addKernel( "mitchell", 2, mitchellWeight );
+	addKernel( "lanczos3", 3, lanczos3Weight );
+}
+
+int registerFilter( const char name[], double support,
+	double (*weight)( double ) )
+{
+	lock_guard<mutex> guard( registryLock );
+
+	addBuiltIns();
+
+	if ( !( support > 0 ) || weight == NULL )
+		throw (string)"Filter needs a positive support and a weight!";
+
+	for ( size_t i = 0; i < kernels.size(); i++ )
+		if ( strcmp( kernels[i].name, name ) == 0 )
+			throw (string)"There is already a filter called " + name + "!";
+
+	return addKernel( name, support, weight );
+}
+
+int findFilter( const char name[] )
+{
+	lock_guard<mutex> guard( registryLock );
+
+	addBuiltIns();
+
+	for ( size_t i = 0; i < kernels.size(); i++ )
+		if ( strcmp( kernels[i].name, name ) == 0 )
+			return i;
+
+	return -1;
+}
+
+int filterCount()
+{
+	lock_guard<mutex> guard( registryLock );
+
+	addBuiltIns();
+
+	return kernels.size();
+}
+
+FilterKernel getFilter( int id )
+{
+	lock_guard<mutex> guard( registryLock );
+
+	addBuiltIns();
+
+	if ( id < 0 || id >= (int)kernels.size() )
+		throw (string)"No such filter!";
+
+	return kernels[id];
+}
+
+/******************************************************************************\
+ every output gets the same number of taps so apply has no special cases,
+ taps outside the kernel just weigh 0
+\******************************************************************************/
+FilterWeights::FilterWeights( int filter, int inSamples, int outSamples )
+	: in( inSamples ), out( outSamples )
+{
+	FilterKernel kernel = getFilter( filter );
+
+	if ( in < 1 || out < 1 )
+		throw (string)"Can't resample to or from no samples!";
+
+	double scale = (double)in / out;
+	double stretch = max( scale, 1.0 );
+	double support = kernel.support * stretch;
+
+	taps = (int)ceil( 2*support ) + 1;
+	index.resize( (long)out * taps );
+	weight.resize( (long)out * taps );
+
+	for ( int k = 0; k < out; k++ )
+	{
+		double center = ( k + 0.5 )*scale - 0.5;
+		int lo = (int)ceil( center - support );
+		int *idx = &index[(long)k * taps];
+		double *w = &weight[(long)k * taps];
+		double total = 0;
+
+		for ( int t = 0; t < taps; t++ )
+		{
+			idx[t] = min( max( lo + t, 0 ), in - 1 );
+			w[t] = kernel.weight( ( lo + t - center ) / stretch );
+			total += w[t];
+		}
+
+		// a kernel that misses every input (a box between two samples)
+		// takes the nearest one
+		if ( fabs( total ) < 1e-12 )
+		{
+			for ( int t = 0; t < taps; t++ )
+				w[t] = 0;
+			idx[0] = min( max( (int)floor( center + 0.5 ), 0 ), in - 1 );
+			w[0] = total = 1;
+		}
+
+		for ( int t = 0; t < taps; t++ )
+			w[t] /= total;
+	}
+}
+
+int FilterWeights::inSize() const
+{
+	return in;
+}
+
+int FilterWeights::outSize() const
+{
+	return out;
+}
+
+void FilterWeights::apply( const double y[], long width, int k,
+	double dst[] ) const
+{
+	const int *idx = &index[(long)k * taps];
+	const double *w = &weight[(long)k * taps];
+
+	for ( long c = 0; c < width; c++ )
+		dst[c] = 0;
+
+	// one tap at a time so the inner loop runs along a row
+	for ( int t = 0; t < taps; t++ )
+	{
+		const double *src = y + idx[t]*width;
+		double wt = w[t];
+
+		if ( wt == 0 )
+			continue;
+
+		for ( long c = 0; c < width; c++ )
+			dst[c] += wt*src[c];
+	}
+}
+
+static mutex cacheLock;
+static map<tuple<int,int,int>, shared_ptr<const FilterWeights> > weightCache;
+static map<int, shared_ptr<const PhaseWeights> > phaseCache;
+
+shared_ptr<const FilterWeights> getFilterWeights( int filter, int in, int out )
+{
+	tuple<int,int,int> key( filter, in, out );
+
+	{
+		lock_guard<mutex> guard( cacheLock );
+		auto found = weightCache.find( key );
+		if ( found != weightCache.end() )
+			return found->second;
+	}
+
+	// worked out without the lock, two threads may both build the same set
+	shared_ptr<const FilterWeights> weights( new FilterWeights( filter, in,
+	    out ) );
+
+	lock_guard<mutex> guard( cacheLock );
+
+	if ( weightCache.size() >= WEIGHT_CACHE )
+		weightCache.clear();
+	weightCache[key] = weights;
+
+	return weights;
+}
+
+// min and max take PHASES by reference so it needs a definition
+constexpr int PhaseWeights::PHASES;
+
+/******************************************************************************\
+ the taps of a position cover every pixel within the support on either side,
+ phase p stands for the fraction p / PHASES
+\******************************************************************************/
+PhaseWeights::PhaseWeights( int filter )
+{
+	FilterKernel kernel = getFilter( filter );
+	int reach = (int)ceil( kernel.support );
+
+	count = 2*reach;
+	offset = reach - 1;
+	weight.resize( ( PHASES+1 ) * count );
+
+	for ( int p = 0; p <= PHASES; p++ )
+	{
+		double f = (double)p / PHASES;
+		double *w = &weight[p * count];
+		double total = 0;
+
+		for ( int t = 0; t < count; t++ )
+		{
+			w[t] = kernel.weight( t - offset - f );
+			total += w[t];
+		}
+
+		if ( fabs( total ) < 1e-12 )
+		{
+			for ( int t = 0; t < count; t++ )
+				w[t] = 0;
+			w[offset + ( f > 0.5 )] = total = 1;
+		}
+
+		for ( int t = 0; t < count; t++ )
+			w[t] /= total;
+	}
+}
+
+int PhaseWeights::size() const
+{
+	return count;
+}
+
+int PhaseWeights::first() const
+{
+	return offset;
+}
+
+const double *PhaseWeights::taps( double f ) const
+{
+	int p = (int)( f*PHASES + 0.5 );
+
+	return &weight[min( max( p, 0 ), PHASES ) * count];
+}
+
+shared_ptr<const PhaseWeights> getPhaseWeights( int filter )
+{
+	{
+		lock_guard<mutex> guard( cacheLock );
+		auto found = phaseCache.find( filter );
+		if ( found != phaseCache.end() )
+			return found->second;
+	}
+
+	shared_ptr<const PhaseWeights> weights( new PhaseWeights( filter ) );
+
+	lock_guard<mutex> guard( cacheLock );
+	phaseCache[filter] = weights;
+
+	return weights;
+}
@@ -0,0 +1,126 @@
+/******************************************************************************\
+ Filter kernels for resampling.  A kernel is a weight function that is 0
+ outside [-support, support], a sample between pixels is the weighted sum of
+ the pixels within the support around it.  Unlike the natural spline in
+ Resampler every output only depends on a few inputs, and a kernel can be
+ picked per job to trade quality for speed:
+
+   name          support   notes
+   box           0.5       nearest pixel when enlarging, block average when
+                           shrinking
+   triangle      1         bilinear
+   catmull-rom   2         sharp cubic, passes through every pixel
+   mitchell      2         Mitchell-Netravali B = C = 1/3, softer cubic with
+                           less ringing
+   lanczos3      3         windowed sinc, sharpest, rings on hard edges
+
+ Kernels live in a registry so new ones can be added with registerFilter and
+ looked up by name.  The weights of a kernel only depend on the sizes before
+ and after resampling (or on the fraction of a pixel for rotations), so they
+ are worked out once and shared by every call with the same kernel and sizes.
+\******************************************************************************/
+
+#ifndef FILTERKERNEL_H
+#define FILTERKERNEL_H
+
+#include <vector>
+#include <memory>
+
+// ids of the built in kernels, registerFilter hands out ids after these
+enum FilterType { FILTER_BOX, FILTER_TRIANGLE, FILTER_CATMULL_ROM,
+	FILTER_MITCHELL, FILTER_LANCZOS3 };
+
+struct FilterKernel
+{
+	const char *name;
+	double support;				// weight is 0 outside [-support, support]
+	double (*weight)( double );
+};
+
+// name : registerFilter
+// input : a name, the support and the weight function of a kernel
+// output : adds the kernel to the registry and returns its id, throws a
+//          string if the name is taken or the support isn't positive
+int registerFilter( const char[], double, double (*)( double ) );
+
+// name : findFilter
+// input : a kernel's name
+// output : its id, -1 if there is no kernel by that name
+int findFilter( const char[] );
+
+// number of kernels in the registry, ids are 0 up to this
+int filterCount();
+
+// name : getFilter
+// input : a kernel id
+// output : the kernel, throws a string for an id that isn't registered
+FilterKernel getFilter( int );
+
+/******************************************************************************\
+ FilterWeights resamples in samples along an axis to out samples.  Sample k
+ of out is centred at (k + 0.5) * in/out - 0.5 of in.  When shrinking the
+ kernel is stretched by in/out so every input is counted.  Inputs past the
+ ends repeat the end samples and each output's weights add up to 1.  Data is
+ laid out as in Resampler, "in" rows of "width" values
+\******************************************************************************/
+class FilterWeights
+{
+public:
+	// name : FilterWeights
+	// input : kernel id, number of samples before and after
+	// output : works out the taps of every output
+	FilterWeights( int, int, int );
+
+	int inSize() const;
+	int outSize() const;
+
+	// name : apply
+	// input : in rows of width values, width, an output position and an
+	//         array of width values
+	// output : sets the array to output k of every column
+	void apply( const double[], long, int, double[] ) const;
+
+private:
+	int in, out;
+	int taps;					// taps per output, unused ones weigh 0
+	std::vector<int> index;		// out x taps input rows (already clamped)
+	std::vector<double> weight;	// out x taps weights
+};
+
+// name : getFilterWeights
+// input : kernel id, samples before and after
+// output : the weights for those sizes, shared with every other caller
+//          asking for the same ones (sets are kept until there are too many,
+//          then the cache is emptied and starts over)
+std::shared_ptr<const FilterWeights> getFilterWeights( int, int, int );
+
+/******************************************************************************\
+ PhaseWeights samples at any fraction of a pixel, as rotations need.  The
+ fraction is rounded to one of PHASES steps and each step has its own
+ precomputed taps (normalized to add up to 1), so sampling a position is a
+ table lookup and a short dot product.  Tap t of a position p weighs the
+ pixel floor(p) - first() + t
+\******************************************************************************/
+class PhaseWeights
+{
+public:
+	static constexpr int PHASES = 64;
+
+	PhaseWeights( int );
+
+	// taps per position and the offset of the first one
+	int size() const;
+	int first() const;
+
+	// the taps for a fraction in [0,1)
+	const double *taps( double ) const;
+
+private:
+	int count, offset;
+	std::vector<double> weight;	// ( PHASES+1 ) x count
+};
+
+// the phase weights of a kernel, shared like getFilterWeights
+std::shared_ptr<const PhaseWeights> getPhaseWeights( int );
+
+#endif
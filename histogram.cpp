@@ -0,0 +1,181 @@
+#include <cmath>
+#include <string>
+#include "histogram.h"
+
+using namespace std;
+
+/******************************************************************************\
+ default constructor, an empty histogram of one level
+\******************************************************************************/
+Histogram::Histogram()
+	: Q( 0 ), channels( 1 ), counts( 1, 0 )
+{
+}
+
+int Histogram::getLevels() const
+{
+	return Q;
+}
+
+int Histogram::getChannels() const
+{
+	return channels;
+}
+
+const long long *Histogram::channel( int c ) const
+{
+	if ( c < 0 || c >= channels )
+		throw (string)"Histogram doesn't have that channel!";
+
+	return &counts[(long)c * ( Q+1 )];
+}
+
+long long Histogram::total() const
+{
+	const long long *h = channel( 0 );
+	long long sum = 0;
+
+	for ( int v = 0; v <= Q; v++ )
+		sum += h[v];
+
+	return sum;
+}
+
+long long Histogram::count( int level, int c ) const
+{
+	if ( level < 0 || level > Q )
+		return 0;
+
+	return channel( c )[level];
+}
+
+double Histogram::mean( int c ) const
+{
+	const long long *h = channel( c );
+	double sum = 0;
+	long long n = 0;
+
+	for ( int v = 0; v <= Q; v++ )
+	{
+		sum += (double)v * h[v];
+		n += h[v];
+	}
+
+	return n == 0 ? 0 : sum / n;
+}
+
+/******************************************************************************\
+ every split t puts [0,t] in the dark class and (t,Q] in the bright one, the
+ best split has the largest wB * wF * ( meanB - meanF )^2.  The class weights
+ and sums are kept running so each split costs the same
+\******************************************************************************/
+int Histogram::otsu( int c ) const
+{
+	const long long *h = channel( c );
+	double sum = 0, sumB = 0, best = -1;
+	long long n = 0, wB = 0;
+	int split = -1, lowest = -1;
+
+	for ( int v = 0; v <= Q; v++ )
+	{
+		sum += (double)v * h[v];
+		n += h[v];
+		if ( lowest < 0 && h[v] > 0 )
+			lowest = v;
+	}
+
+	for ( int t = 0; t < Q; t++ )
+	{
+		wB += h[t];
+		sumB += (double)t * h[t];
+
+		long long wF = n - wB;
+		if ( wB == 0 )
+			continue;
+		if ( wF == 0 )
+			break;
+
+		double diff = sumB / wB - ( sum - sumB ) / wF;
+		double between = (double)wB * wF * diff * diff;
+
+		if ( between > best )
+		{
+			best = between;
+			split = t;
+		}
+	}
+
+	// only one level is used, everything is below the level above it
+	if ( split < 0 )
+		return min( max( lowest, 0 ) + 1, Q );
+
+	return split + 1;
+}
+
+/******************************************************************************\
+ the line runs from the peak to one level past the last used level of the
+ longer tail (where the count is taken to be 0).  The level furthest below
+ the line is the split, the distance to the line is proportional to how far
+ below it the count is so that's what is compared
+\******************************************************************************/
+int Histogram::triangle( int c ) const
+{
+	const long long *h = channel( c );
+	int lo = -1, hi = -1, peak = 0;
+
+	for ( int v = 0; v <= Q; v++ )
+		if ( h[v] > 0 )
+		{
+			if ( lo < 0 )
+				lo = v;
+			hi = v;
+		}
+
+	for ( int v = 0; v <= Q; v++ )
+		if ( h[v] > h[peak] )
+			peak = v;
+
+	if ( lo < 0 || lo == hi )
+		return min( max( lo, 0 ) + 1, Q );
+
+	bool right = ( hi - peak >= peak - lo );
+	int end = ( right ? hi + 1 : lo - 1 );
+	int step = ( right ? 1 : -1 );
+	double top = h[peak];
+	double best = -1;
+	int split = peak;
+
+	for ( int t = peak + step; t != end; t += step )
+	{
+		double line = top * ( end - t ) / ( end - peak );
+		double below = line - h[t];
+
+		if ( below > best )
+		{
+			best = below;
+			split = t;
+		}
+	}
+
+	return min( split + 1, Q );
+}
+
+int Histogram::percentile( double fraction, int c ) const
+{
+	const long long *h = channel( c );
+	long long below = 0;
+
+	if ( !( fraction >= 0 && fraction <= 1 ) )
+		throw (string)"Percentile has to be between 0 and 1!";
+
+	double target = fraction * total();
+
+	for ( int v = 0; v <= Q; v++ )
+	{
+		if ( below >= target )
+			return v;
+		below += h[v];
+	}
+
+	return Q;
+}
@@ -0,0 +1,173 @@
+/******************************************************************************\
+ Histogram counts how many pixels of an image have each level, per channel
+ for color images.  It is built in one pass over the image, each band of
+ rows from the thread pool counts into its own histograms which are added
+ together at the end, and inside a band consecutive pixels count into
+ separate copies so a run of the same level doesn't wait on one counter.
+
+ Once it's built every automatic threshold only looks at the Q+1 counts:
+
+   otsu         the level that best splits the pixels into two classes
+                (largest variance between the classes)
+   triangle     draws a line from the peak of the histogram to the far end
+                of its longer tail and picks the level furthest below it,
+                good for a few bright objects on a big dark background
+   percentile   the level a given fraction of the pixels are below
+
+ Each returns the lowest level of the bright class, the value to pass to
+ ImageType::threshold.  Values outside [0,Q] are counted as 0 or Q.
+\******************************************************************************/
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <vector>
+#include <string>
+#include <mutex>
+#include "pixelTraits.h"
+#include "parallel.h"
+
+template <class pType> class ImageType;
+
+// the most levels a histogram can have
+const int MAX_HISTOGRAM_LEVELS = 65535;
+
+class Histogram
+{
+public:
+	// name : Histogram
+	// input : nothing, or the image to count
+	// output : an empty histogram, or the histogram of the image
+	Histogram();
+	template <class pType>
+	Histogram( const ImageType<pType>& );
+
+	// name : build
+	// input : an image
+	// output : replaces the counts with the image's, throws a string if the
+	//          image has more than MAX_HISTOGRAM_LEVELS levels
+	template <class pType>
+	void build( const ImageType<pType>& );
+
+	// name : add
+	// input : an image with the same levels and channels
+	// output : adds its counts, so an image read a band at a time is counted
+	//          by building from the first band and adding the rest.  Throws
+	//          a string if the levels or channels differ
+	template <class pType>
+	void add( const ImageType<pType>& );
+
+	// Q and the number of channels (1 or 3) of the image counted
+	int getLevels() const;
+	int getChannels() const;
+
+	// number of pixels counted
+	long long total() const;
+
+	// name : count
+	// input : a level and a channel
+	// output : the number of pixels with that level in that channel, 0 for
+	//          levels outside [0,Q]
+	long long count( int, int = 0 ) const;
+
+	// the average level of a channel
+	double mean( int = 0 ) const;
+
+	// name : otsu, triangle, percentile
+	// input : the fraction of pixels below the level for percentile (0 to
+	//         1), and a channel
+	// output : the lowest level of the bright pixels.  If every pixel has
+	//          the same level otsu and triangle give the level above it (Q
+	//          at most).  percentile throws a string for a fraction outside
+	//          [0,1]
+	int otsu( int = 0 ) const;
+	int triangle( int = 0 ) const;
+	int percentile( double, int = 0 ) const;
+
+private:
+	// the counts of a channel
+	const long long *channel( int ) const;
+
+	int Q;
+	int channels;
+	std::vector<long long> counts;	// channels x ( Q+1 )
+};
+
+template <class pType>
+Histogram::Histogram( const ImageType<pType>& img )
+	: Q( 0 ), channels( 1 )
+{
+	build( img );
+}
+
+template <class pType>
+void Histogram::build( const ImageType<pType>& img )
+{
+	int N, M, levels;
+
+	img.getImageInfo( N, M, levels );
+
+	if ( levels < 0 || levels > MAX_HISTOGRAM_LEVELS )
+		throw (std::string)"Too many levels for a histogram!";
+
+	Q = levels;
+	channels = pixelTraits<pType>::color ? 3 : 1;
+	counts.assign( (long)channels * ( Q+1 ), 0 );
+
+	add( img );
+}
+
+/******************************************************************************\
+ with fewer levels each band keeps four copies of its histograms and pixel j
+ counts into copy j % 4, the copies are added up with the other bands
+\******************************************************************************/
+template <class pType>
+void Histogram::add( const ImageType<pType>& img )
+{
+	typedef pixelTraits<pType> traits;
+	typedef typename traits::channel sample;
+
+	const int C = traits::color ? 3 : 1;
+	int N, M, levels;
+	std::mutex lock;
+
+	img.getImageInfo( N, M, levels );
+
+	if ( levels != Q || C != channels )
+		throw (std::string)"Image doesn't match the histogram!";
+
+	const int copies = ( Q < 4096 ? 4 : 1 );
+	const long size = (long)C * ( Q+1 );
+
+	parallelFor( N, 64, [&]( int first, int last )
+	{
+		std::vector<long long> local( copies * size, 0 );
+
+		for ( int i = first; i < last; i++ )
+		{
+			const sample *row = reinterpret_cast<const sample*>(
+			    img.getRow(i) );
+
+			for ( int j = 0; j < M; j++ )
+			{
+				long long *h = &local[( j & ( copies-1 ) ) * size];
+
+				for ( int c = 0; c < C; c++ )
+				{
+					int v = row[j*C + c];
+
+					v = ( v < 0 ? 0 : ( v > Q ? Q : v ) );
+					h[c*( Q+1 ) + v]++;
+				}
+			}
+		}
+
+		std::lock_guard<std::mutex> guard( lock );
+
+		for ( int k = 0; k < copies; k++ )
+			for ( long v = 0; v < size; v++ )
+				counts[v] += local[k*size + v];
+	} );
+}
+
+#endif
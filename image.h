@@ -14,23 +14,82 @@
 #include <iostream>
 #include <cstdlib>
 #include <cmath>
-#include "cubicSpline.h"
+#include <new>
+#include <algorithm>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <limits>
+#include "resampler.h"
+#include "parallel.h"
+#include "transform.h"
+#include "summedArea.h"
+#include "filterKernel.h"
+#include "pointMap.h"
+#include "histogram.h"
+#include "morphology.h"
+#include "pixelKernels.h"
+#include "sampleStats.h"
+#include "pixelTraits.h"
 
 using namespace std;
 
 // size of one grid on the background grid
 const int BACKGRID = 25;
 
+// byte alignment of the pixel buffer and of the start of every row
+const int PIXEL_ALIGN = 64;
+
+// fraction bits of the source coordinates the rotation walks along a row,
+// and bits of the weights it samples with
+const int COORD_BITS = 32;
+const int WEIGHT_BITS = 15;
+
+// side of the square tiles whole pixel rotations are copied in
+const int ROTATE_TILE = 64;
+
+// what setImageInfo fills the pixels with after (re)sizing the image
+//   FILL_NONE       - pixels are left as they are, use when every pixel is
+//                     about to be overwritten anyway
+//   FILL_ZERO       - every pixel is set to 0 (black)
+//   FILL_BACKGROUND - the checkered background grid is painted
+enum FillType { FILL_NONE, FILL_ZERO, FILL_BACKGROUND };
+
+// how warpAffine and warpPerspective find the value between pixels
+//   SAMPLE_NEAREST  - the closest pixel
+//   SAMPLE_BILINEAR - blend of the four pixels around the position
+//   SAMPLE_BICUBIC  - cubic (Catmull-Rom) blend of the sixteen pixels around
+//                     the position, sharper than bilinear
+enum SampleType { SAMPLE_NEAREST, SAMPLE_BILINEAR, SAMPLE_BICUBIC };
+
+// ways of picking a threshold automatically, see histogram.h
+//   THRESHOLD_MEAN       - 2/5 of the way from the mean of the pixels above
+//                          the image's mean to Q (what threshold() has
+//                          always done)
+//   THRESHOLD_OTSU       - best split into two classes
+//   THRESHOLD_TRIANGLE   - furthest below a line from the histogram's peak
+//                          to the end of its tail, for sparse bright objects
+//   THRESHOLD_PERCENTILE - the level a fraction of the pixels are below
+enum ThresholdType { THRESHOLD_MEAN, THRESHOLD_OTSU, THRESHOLD_TRIANGLE,
+	THRESHOLD_PERCENTILE };
+
+// pType can be any of the pixel types described in pixelTraits.h, arithmetic
+// is carried out in the wide type of the pixel and saturated when stored
 template <class pType>
 class ImageType {
 public:
+	// conversions for the pixel type and the type used for intermediate
+	// calculations on pixels
+	typedef pixelTraits<pType> traits;
+	typedef typename traits::wide wide;
 
 // CONSTRUCTORS AND DESTRUCTOR /////////////////////////////////////////////////
 	// default construtor, sets everything to NULL and 0
 	ImageType();
 
-	// parameterized constructor sets up image to N, M and Q values
-	ImageType(int, int, int);
+	// parameterized constructor sets up image to N, M and Q values and fills
+	// it as described by the FillType
+	ImageType(int, int, int, FillType=FILL_BACKGROUND);
 
 	// copy allocates memory and copies info from the right hand side
 	ImageType( const ImageType<pType>& );
@@ -38,6 +97,14 @@ public:
 	// same as copy except it de-allocates memory first if necessary
 	ImageType<pType>& operator= ( const ImageType<pType>& );
 
+	// move constructor and assignment take the pixel buffer from the right
+	// hand side without copying, leaving it as an empty image
+	ImageType( ImageType<pType>&& );
+	ImageType<pType>& operator= ( ImageType<pType>&& );
+
+	// exchange the contents (buffer, N, M and Q) of two images in O(1)
+	void swap( ImageType<pType>& );
+
 	// destructor removes all dynamically allocated memory
 	~ImageType();
 	
@@ -46,7 +113,11 @@ public:
 	void getImageInfo(int&, int&, int&) const;
 
 	// sets N, M and Q and also de-allocates and allocates memory if necessary
-	void setImageInfo(int, int, int);
+	// then fills the pixels as described by the FillType
+	void setImageInfo(int, int, int, FillType=FILL_BACKGROUND);
+
+	// paint the checkered background grid over the entire image
+	void paintBackground();
 
 	// sets the value of a pixel at row, column to the 3rd parameters value
 	void setPixelVal(int, int, pType);
@@ -54,9 +125,54 @@ public:
 	// return the pixel value at the desired location
 	pType getPixelVal(int, int) const;
 
-	// returns the mean value of all the pixels
+	// returns a pointer to the first pixel of a row, the pixels of a row are
+	// contiguous and the next row starts getStride() pixels later
+	pType* getRow(int);
+	const pType* getRow(int) const;
+
+	// returns the number of pixels between the start of two rows, this is
+	// at least the number of columns (rows are padded to PIXEL_ALIGN bytes)
+	int getStride() const;
+
+	// make the image use a buffer it doesn't own (rows, cols, levels and the
+	// stride in pixels), for example pages of a memory mapped file.  When
+	// the image is done with the buffer (destroyed or re-allocated) the
+	// function is called with the handle, it may be NULL.  The buffer does
+	// not have to be aligned to PIXEL_ALIGN
+	void setBuffer( pType*, int, int, int, int, void (*)(void*)=NULL,
+	    void* =NULL );
+
+	// returns the mean value of all the pixels (of each channel for color,
+	// truncated toward 0)
 	pType meanColor() const;
 
+	// name : statistics
+	// input : a SampleStats for each channel (one, or three for color)
+	// output : sets them to the count, sum, sum of squares, min and max of
+	//          the channel over the whole image, see sampleStats.h
+	void statistics( SampleStats[] ) const;
+
+	// name : pyramidLevel
+	// input : a pyramid level k >= 0
+	// output : the image reduced by 2^k, every pixel the average of a
+	//          2^k x 2^k block of the image rounded half up (rows and columns
+	//          left over at the end are dropped).  Level 0 is the image
+	//          itself.  Levels are built the first time they're asked for and
+	//          kept until the image changes (a view's are built again every
+	//          time), so don't hold on to one across a change.  Not safe to call from two threads at once on the same
+	//          image.  Throws a string if the image is too small to reduce
+	//          that far
+	const ImageType<pType>& pyramidLevel( int ) const;
+
+	// pyramid level that is exactly rows x cols, where the image divides into
+	// whole 2^k x 2^k blocks, or 0 if there isn't one
+	int pyramidLevelFor( int, int ) const;
+
+	// throws the pyramid away.  Every change made through the image or a view
+	// of it does this on its own, only changes made through a row pointer
+	// kept from before the pyramid was built need it
+	void dropPyramid();
+
 	// enlarge the image by a factor is s, uses bi-cubic interpolation if the
 	// bool is true, otherwise uses bi-linear interpolation which is more light
 	// weight.  The version with an int value for s simply casts s to a double
@@ -64,6 +180,19 @@ public:
 	void enlargeImage( double, const ImageType<pType>& );
 	void enlargeImage( int, const ImageType<pType>& );
 
+	// name : resampleImage
+	// input : rows and cols of the result, the old image and a filter id
+	//         (FILTER_BOX ... FILTER_LANCZOS3 or one from registerFilter)
+	// output : old stretched or squeezed to rows x cols with the filter,
+	//          first along the rows and then down the columns.  Values are
+	//          rounded and kept in [0,Q].  Throws a string for an unknown
+	//          filter or a size less than 1
+	void resampleImage( int, int, const ImageType<pType>&, int );
+
+	// enlarge by s (the same size as enlargeImage gives) with a filter
+	// instead of the natural spline
+	void enlargeImage( double, const ImageType<pType>&, int );
+
 	// reflect the image either horiz. or vert. depending on the bool value
 	void reflectImage( bool, const ImageType<pType>& );
 
@@ -74,14 +203,46 @@ public:
 	// calculate the negative of every pixel (Q - current value)
 	void negateImage();
 
+	// name : applyMap
+	// input : a PointMap made for this image's Q and channels (3 for color
+	//         images, 1 otherwise)
+	// output : every channel of every pixel is changed by the map, saturated
+	//          to the pixel type.  Throws a string if the map doesn't match
+	void applyMap( const PointMap& );
+
+	// raise every channel to a power, Q * (value/Q)^gamma.  Below 1
+	// brightens and above 1 darkens
+	void gammaImage( double );
+
+	// stretch the levels low to high over the whole range 0 to Q, anything
+	// below low becomes 0 and anything above high becomes Q
+	void stretchImage( int, int );
+
 	// calculate a sub image given the row,col for the upper left and lower
 	// right corners
 	void getSubImage( int, int, int, int, const ImageType<pType>& );
 
+	// make this image a view of the same region of another image (the same
+	// corners getSubImage takes), nothing is copied.  The view shares the
+	// other image's pixels, so any operation that keeps the size of the view
+	// reads and writes the region in place.  Views of regions that don't
+	// overlap can be worked on at the same time.  The view must not outlive
+	// the other image's buffer, resizing the view detaches it
+	void getSubView( int, int, int, int, ImageType<pType>& );
+
 	// shrink image by a factor of s, find the average value for each 'block' of
 	// pixels that is reduced and use that value.  This makes a smoother reduce
-	// function
-	void shrinkImage( int, const ImageType<pType>& );
+	// function.  s can be any factor > 0, blocks are fractions of pixels
+	// wide and partly covered pixels count for the part covered
+	void shrinkImage( double, const ImageType<pType>& );
+
+	// shrink by s (the same size as shrinkImage gives) with a filter, which
+	// is stretched by s so every pixel of old counts
+	void shrinkImage( double, const ImageType<pType>&, int );
+
+	// every pixel becomes the average of the square of pixels within r of it
+	// (the part of the square inside the image), the same cost for any r
+	void boxFilter( int, const ImageType<pType>& );
 
 	// translate the image down to the right by t pixels, effectively cutting
 	// off the bottom and right side by the same number of pixels
@@ -90,6 +251,24 @@ public:
 	// rotate image by theta degrees counter-clockwise
 	void rotateImage( int, const ImageType<pType>& );
 
+	// rotate with a filter from filterKernel.h instead of the bilinear blend,
+	// the same pixels are covered
+	void rotateImage( int, const ImageType<pType>&, int );
+
+	// name : warpAffine, warpPerspective
+	// input : a transform from positions in old to positions in this image,
+	//         the old image, how to sample between pixels and the size of the
+	//         result (0 rows or cols keeps the size of old)
+	// output : this image is old moved by the transform, sampled only once
+	//          however many transforms were combined into it.  Parts not
+	//          covered by old show the background.  warpAffine throws a
+	//          string if the transform isn't affine, both throw if it can't
+	//          be undone
+	void warpAffine( const Transform&, const ImageType<pType>&,
+	    SampleType=SAMPLE_BILINEAR, int=0, int=0 );
+	void warpPerspective( const Transform&, const ImageType<pType>&,
+	    SampleType=SAMPLE_BILINEAR, int=0, int=0 );
+
 	// sum two images giving no particular bias to one or the other
 	ImageType& operator+ ( const ImageType<pType>& );
 
@@ -99,22 +278,148 @@ public:
 	// determine threshold value automatically
     void threshold();
 
+	// name : threshold
+	// input : how to pick the level and, for THRESHOLD_PERCENTILE, the
+	//         fraction of pixels (0 to 1) that go black
+	// output : thresholds the image at the level picked from its histogram,
+	//          color images get a level per channel
+	void threshold( ThresholdType, double=0.99 );
+
+	// name : meanLevel
+	// input : the histogram of a grayscale image and its Q
+	// output : the level threshold() picks for that image
+	static int meanLevel( const Histogram&, int );
+
     // dilate the image (assuming it has already been thresholded)
 	void dilate();
 
 	// erode the image (assuming it has already been thresholded)
 	void erode();
 
+	// name : erode, dilate
+	// input : the structuring element, see morphology.h
+	// output : sets every pixel to 0 (erode) or Q (dilate) if any pixel
+	//          under the element around it is, the cost doesn't depend on
+	//          the size of the element.  erode() and dilate() use the 3x3
+	//          square
+	void erode( const StructuringElement& );
+	void dilate( const StructuringElement& );
+
 	// make the entire image black
 	void blackOut();
 
 private:
+	// allocates an aligned buffer for rows x cols pixels and sets N, M and
+	// stride, any previous buffer is released first
+	void allocate(int, int);
+
+	// destroys the pixels and frees the buffer, or hands a borrowed buffer
+	// back to its owner
+	void release();
+
+	// makes the pixels of a temporary the result of an operation, they are
+	// swapped in unless this image is a view, which has to be written to
+	void takeResult( ImageType<pType>& );
+
+	// marks the pyramid of this image out of date, and those of the images
+	// it's a view of since their pixels are the same
+	void markChanged();
+
+	// fixed point numbers used to walk source coordinates across a row
+	typedef long long fixed;
+
+	// fills every pixel (i,j) that lands inside old with the bilinear sample
+	// of old at row map[0] + map[1]*i + map[2]*j and column cmap[0] +
+	// cmap[1]*i + cmap[2]*j, pixels that land outside are left alone.  The
+	// last parameter is the smallest fixed point row or column that counts
+	// as inside, 1 (just past 0) for the rotation and 0 for warps
+	void sampleMapped( const ImageType<pType>&, const double[3],
+	    const double[3], fixed );
+
+	// same as sampleMapped for a map of whole pixels (every coefficient an
+	// int and the j steps -1, 0 or 1), which is a straight copy
+	void copyMapped( const ImageType<pType>&, const int[3], const int[3],
+	    fixed );
+
+	// sample old at a fixed point position that isn't strictly inside it,
+	// the pixel is left alone if the position is outside
+	void sampleEdge( const ImageType<pType>&, fixed, fixed, pType&, fixed )
+	    const;
+
+	// works out where rotateImage samples pixel (i,j) of this image from, as
+	// rowMap and colMap of sampleMapped, true if they're whole pixels
+	bool rotationMap( int, double[3], double[3] ) const;
+
+	// same as sampleMapped with the taps of a filter instead of the bilinear
+	// blend, only sources strictly inside old (0 < r < N, 0 < c < M) are
+	// sampled, taps past the edges repeat the edge pixels
+	void sampleFiltered( const ImageType<pType>&, const double[3],
+	    const double[3], int );
+
+	// rounds each channel to the nearest level, keeps it in [0,Q] and
+	// narrows it to a pixel
+	static pType roundPixel( const double[], int );
+
+	// warps through any transform (inverse given), one position at a time
+	void samplePoints( const ImageType<pType>&, const Transform&,
+	    SampleType );
+
+	// sample old at a row and column with any of the SampleTypes, the pixel
+	// is left alone if the position is outside
+	void samplePoint( const ImageType<pType>&, double, double, SampleType,
+	    pType& ) const;
+
+	// narrows [lo,hi) to the j where from <= start + j*step < limit
+	static void clipSpan( fixed, fixed, fixed, fixed, int&, int& );
+
+	// narrows [lo,hi) to the j where from <= start + j*step <= limit, step
+	// must be -1, 0 or 1
+	static void clipSteps( int, int, int, int, int&, int& );
+
+	// Catmull-Rom weights of the four pixels around a fraction
+	static void cubicWeights( double, double[4] );
+
+	// sets every pixel to value if a pixel under the element around it is
+	void morph( const StructuringElement&, int );
+
+	// name : reduceRows
+	// input : stats for each channel and a function that adds a row of
+	//         pixels into stats for each channel
+	// output : runs the function over every row (in parallel) and sets the
+	//          stats to the pairwise total of the rows
+	template <class RowFunc>
+	void reduceRows( SampleStats[], const RowFunc& ) const;
+
+	// the level threshold() picks, from the pixels themselves (needed for
+	// color images, whose pixels are compared as a whole)
+	wide meanLevel() const;
+
+	// blends two or four values by fixed point weights of WEIGHT_BITS bits
+	static wide lerp( const wide&, const wide&, int );
+	static wide bilerp( const wide&, const wide&, const wide&, const wide&,
+	    int, int );
+
 	int N; // # of rows
 	int M; // # of cols
 	int Q; // # of gray-level values
+	int stride; // # of pixels from the start of one row to the next
+
+	// contiguous array of N*stride pixel values, row i starts at i*stride
+	pType *pixelValue;
+
+	// set when pixelValue belongs to someone else (see setBuffer)
+	bool borrowed;
+	void (*bufRelease)(void*);
+	void *bufHandle;
+
+	// the image this is a view of (see getSubView), NULL for any other image
+	ImageType<pType> *parent;
 
-	// array of pixel values
-	pType **pixelValue;
+	// levels 1, 2, ... of pyramidLevel, pyramidStale is set when the pixels
+	// may have changed since they were built (the row pointers handed out can
+	// be written from many threads at once, so it's atomic)
+	mutable std::vector<std::unique_ptr<ImageType<pType> > > pyramid;
+	mutable std::atomic<bool> pyramidStale;
 };
 
 
@@ -128,8 +433,14 @@ ImageType<pType>::ImageType()
 	N = 0;
 	M = 0;
 	Q = 0;
+	stride = 0;
 
 	pixelValue = NULL;
+	borrowed = false;
+	bufRelease = NULL;
+	bufHandle = NULL;
+	parent = NULL;
+	pyramidStale = false;
 }
 
 /******************************************************************************\
@@ -138,26 +449,25 @@ ImageType<pType>::ImageType()
 template <class pType>
 ImageType<pType>::~ImageType()
 {
-	if ( pixelValue != NULL )
-	{
-		// delete all the memory for the array
-		for ( int i = 0; i < N; i++ )
-			delete [] pixelValue[i];
-		delete [] pixelValue;
-	}
+	release();
 }
 
 /******************************************************************************\
  change the dimensions of the image, delete and re-allocate memory if required
 \******************************************************************************/
 template <class pType>
-ImageType<pType>::ImageType(int tmpN, int tmpM, int tmpQ)
+ImageType<pType>::ImageType(int tmpN, int tmpM, int tmpQ, FillType fill)
 {
 	pixelValue = NULL;
-	N = M = Q = 0;
+	N = M = Q = stride = 0;
+	borrowed = false;
+	bufRelease = NULL;
+	bufHandle = NULL;
+	parent = NULL;
+	pyramidStale = false;
 
 	// set the new values of N, M and Q
-	setImageInfo( tmpN, tmpM, tmpQ );
+	setImageInfo( tmpN, tmpM, tmpQ, fill );
 }
 
 /******************************************************************************\
@@ -167,14 +477,24 @@ template <class pType>
 ImageType<pType>::ImageType( const ImageType<pType>& rhs )
 {
 	pixelValue = NULL;
-	N = M = Q = 0;
+	N = M = Q = stride = 0;
+	borrowed = false;
+	bufRelease = NULL;
+	bufHandle = NULL;
+	parent = NULL;
+	pyramidStale = false;
 
-	// set the info to the new image data
-	setImageInfo( rhs.N, rhs.M, rhs.Q );
+	// set the info to the new image data, no need to fill since every pixel
+	// is copied next
+	setImageInfo( rhs.N, rhs.M, rhs.Q, FILL_NONE );
 
 	for ( int i = 0; i < N; i++ )
+	{
+		pType *dst = getRow(i);
+		const pType *src = rhs.getRow(i);
 		for ( int j = 0; j < M; j++ )
-			pixelValue[i][j] = rhs.pixelValue[i][j];
+			dst[j] = src[j];
+	}
 }
 
 /******************************************************************************\
@@ -186,17 +506,77 @@ template <class pType>
 ImageType<pType>& ImageType<pType>::operator= ( const ImageType<pType>& rhs )
 {
 	if(this != &rhs){
-		setImageInfo( rhs.N, rhs.M, rhs.Q );
+		setImageInfo( rhs.N, rhs.M, rhs.Q, FILL_NONE );
 
-		// copy pixel values
+		// copy pixel values a row at a time
 		for ( int i = 0; i < N; i++ )
+		{
+			pType *dst = getRow(i);
+			const pType *src = rhs.getRow(i);
 			for ( int j = 0; j < M; j++ )
-				pixelValue[i][j] = rhs.pixelValue[i][j];
+				dst[j] = src[j];
+		}
+	}
+
+	return *this;
+}
+
+/******************************************************************************\
+ move constructor, takes over the buffer of rhs and leaves rhs empty
+\******************************************************************************/
+template <class pType>
+ImageType<pType>::ImageType( ImageType<pType>&& rhs )
+{
+	pixelValue = NULL;
+	N = M = Q = stride = 0;
+	borrowed = false;
+	bufRelease = NULL;
+	bufHandle = NULL;
+	parent = NULL;
+	pyramidStale = false;
+
+	swap( rhs );
+}
+
+/******************************************************************************\
+ move assignment, the old buffer is handed to rhs which then releases it
+\******************************************************************************/
+template <class pType>
+ImageType<pType>& ImageType<pType>::operator= ( ImageType<pType>&& rhs )
+{
+	if ( this != &rhs )
+	{
+		swap( rhs );
+		rhs.release();
+		rhs.Q = 0;
 	}
 
 	return *this;
 }
 
+/******************************************************************************\
+ swaps the buffers and image info of two images, no pixels are copied.  The
+ transforms build their result in a temporary and then swap it in
+\******************************************************************************/
+template <class pType>
+void ImageType<pType>::swap( ImageType<pType>& rhs )
+{
+	std::swap( N, rhs.N );
+	std::swap( M, rhs.M );
+	std::swap( Q, rhs.Q );
+	std::swap( stride, rhs.stride );
+
+	std::swap( pixelValue, rhs.pixelValue );
+	std::swap( borrowed, rhs.borrowed );
+	std::swap( bufRelease, rhs.bufRelease );
+	std::swap( bufHandle, rhs.bufHandle );
+	std::swap( parent, rhs.parent );
+
+	// the pyramid goes with the pixels it was built from
+	pyramid.swap( rhs.pyramid );
+	pyramidStale = rhs.pyramidStale.exchange( pyramidStale );
+}
+
 /******************************************************************************\
  returns the width height and color depth to reference variables
 \******************************************************************************/
@@ -209,50 +589,210 @@ void ImageType<pType>::getImageInfo(int& rows, int& cols, int& levels) const
 } 
 
 /******************************************************************************\
- sets the image info, deleting and allocating memory as required, also create
- background grid
+ sets the image info, deleting and allocating memory as required, then fills
+ the image depending on fill (nothing, black, or the background grid)
 \******************************************************************************/
 template <class pType>
-void ImageType<pType>::setImageInfo(int rows, int cols, int levels)
+void ImageType<pType>::setImageInfo(int rows, int cols, int levels,
+	FillType fill)
 {
-	// re-allocate the integer array if the size changes
+	// whatever the pixels become, they aren't what the pyramid was built from
+	dropPyramid();
+
+	// re-allocate the pixel buffer if the size changes
 	if ( N != rows || M != cols )
+		allocate( rows, cols );
+
+	// set Q equal to the levels
+	Q = levels;
+
+	if ( fill == FILL_ZERO )
+		blackOut();
+	else if ( fill == FILL_BACKGROUND )
+		paintBackground();
+}
+
+/******************************************************************************\
+ make a checkered background.  Squares are BACKGRID pixels wide, the top left
+ square is Q/3 and they alternate with Q/2.  Only the first row of each band
+ of squares is actually calculated (as runs of BACKGRID pixels), every other
+ row is a straight copy of one of those two rows
+\******************************************************************************/
+template <class pType>
+void ImageType<pType>::paintBackground()
+{
+	pType dark, light;
+	dark = Q/3;
+	light = Q/2;
+
+	for ( int i = 0; i < N; i++ )
 	{
-		// delete memory if not NULL
-		if ( pixelValue != NULL )
+		pType *row = getRow(i);
+
+		if ( i < BACKGRID*2 && i % BACKGRID == 0 )
 		{
-			for ( int i = 0; i < N; i++ )
-				delete [] pixelValue[i];
-			delete [] pixelValue;
+			// first row of a band, the odd band starts with the light square
+			bool odd = ( i == BACKGRID );
+			for ( int j = 0; j < M; j += BACKGRID )
+			{
+				bool isLight = ( (j / BACKGRID) % 2 == 1 ) != odd;
+				fill( row + j, row + min(j + BACKGRID, M),
+				    isLight ? light : dark );
+			}
+		}
+		else
+		{
+			// copy the first row of the matching band
+			const pType *src = getRow( i % (BACKGRID*2) < BACKGRID ? 0 :
+			    BACKGRID );
+			copy( src, src + M, row );
 		}
+	}
+}
+
+/******************************************************************************\
+ allocates one contiguous buffer for the whole image.  Each row is padded so
+ that it starts on a PIXEL_ALIGN byte boundary, which lets the operators walk
+ a row linearly and step to the next row by adding the stride
+\******************************************************************************/
+template <class pType>
+void ImageType<pType>::allocate(int rows, int cols)
+{
+	// number of pixels that add up to a multiple of PIXEL_ALIGN bytes
+	int a = PIXEL_ALIGN, b = sizeof(pType), t;
+	while ( b != 0 )
+	{
+		t = a % b;
+		a = b;
+		b = t;
+	}
+	int alignPixels = PIXEL_ALIGN / a;
 
-		// sets N and M
-		N = rows;
-		M = cols;
+	release();
 
-		// allocate the rows of pixel value
-		pixelValue = new pType* [N];
+	N = rows;
+	M = cols;
+	stride = (M + alignPixels - 1) / alignPixels * alignPixels;
 
-		// allocate the columns of pixel value
-		for ( int i = 0; i < N; i++ )
-			pixelValue[i] = new pType[M];
+	if ( N <= 0 || M <= 0 )
+		return;
+
+	void *mem = NULL;
+	if ( posix_memalign( &mem, PIXEL_ALIGN, (size_t)N*stride*sizeof(pType) ) )
+	{
+		N = M = stride = 0;
+		throw (string)"Unable to allocate memory for image!";
 	}
 
-	// set Q equal to the levels
+	// construct every pixel in place (this is free for built in types)
+	pixelValue = static_cast<pType*>(mem);
+	for ( long k = 0; k < (long)N*stride; k++ )
+		new (pixelValue+k) pType;
+}
+
+/******************************************************************************\
+ destroys every pixel and frees the pixel buffer
+\******************************************************************************/
+template <class pType>
+void ImageType<pType>::release()
+{
+	if ( borrowed )
+	{
+		// the owner decides what happens to the buffer
+		if ( bufRelease != NULL )
+			bufRelease( bufHandle );
+	}
+	else if ( pixelValue != NULL )
+	{
+		for ( long k = 0; k < (long)N*stride; k++ )
+			pixelValue[k].~pType();
+		free( pixelValue );
+	}
+
+	pixelValue = NULL;
+	borrowed = false;
+	bufRelease = NULL;
+	bufHandle = NULL;
+	parent = NULL;
+	N = M = stride = 0;
+
+	dropPyramid();
+}
+
+/******************************************************************************\
+ use a buffer owned by someone else as the pixels of this image, nothing is
+ copied.  Writing to the image writes to that buffer
+\******************************************************************************/
+template <class pType>
+void ImageType<pType>::setBuffer( pType *buf, int rows, int cols, int levels,
+	int rowStride, void (*releaseFunc)(void*), void *handle )
+{
+	release();
+
+	pixelValue = buf;
+	N = rows;
+	M = cols;
 	Q = levels;
+	stride = rowStride;
+
+	borrowed = true;
+	bufRelease = releaseFunc;
+	bufHandle = handle;
+}
+
+/******************************************************************************\
+ a view borrows the parent's buffer starting at the upper left corner, rows
+ are still the parent's stride apart.  No release function is needed since
+ the parent owns the pixels
+\******************************************************************************/
+template <class pType>
+void ImageType<pType>::getSubView( int ULr, int ULc, int LRr, int LRc,
+	ImageType<pType>& parent )
+{
+	int width, height;
+
+	// same size as getSubImage would make
+	height = abs(ULr - LRr);
+	width = abs(ULc - LRc);
+
+	if ( this == &parent )
+		throw (string)"An image can't be a view of itself!";
+
+	if ( ULr < 0 || ULc < 0 || ULr + height > parent.N ||
+	     ULc + width > parent.M )
+		throw (string)"Sub image is outside of the image!";
+
+	setBuffer( parent.getRow(ULr) + ULc, height, width, parent.Q,
+	    parent.stride );
+
+	// writes through the view change the parent's pixels
+	this->parent = &parent;
+}
+
+/******************************************************************************\
+ the temporary has to be the same size as this image
+\******************************************************************************/
+template <class pType>
+void ImageType<pType>::takeResult( ImageType<pType>& temp )
+{
+	if ( !borrowed )
+	{
+		swap( temp );
+		return;
+	}
 
-	// make a checkered background
 	for ( int i = 0; i < N; i++ )
-		for ( int j = 0; j < M; j++ )
-		{
-			if ( ( (i%(BACKGRID*2)+1.0) / (BACKGRID*2.0) > 0.5 &&
-				   (j%(BACKGRID*2)+1.0) / (BACKGRID*2.0) <= 0.5 ) ||
-			     ( (i%(BACKGRID*2)+1.0) / (BACKGRID*2.0) <= 0.5 &&
-				   (j%(BACKGRID*2)+1.0) / (BACKGRID*2.0) > 0.5 ) )
-				pixelValue[i][j] = Q/2;
-			else
-				pixelValue[i][j] = Q/3;
-		}
+		copy( temp.getRow(i), temp.getRow(i) + M, getRow(i) );
+}
+
+/******************************************************************************\
+ a view of a view changes the pixels all the way up
+\******************************************************************************/
+template <class pType>
+void ImageType<pType>::markChanged()
+{
+	for ( ImageType<pType> *img = this; img != NULL; img = img->parent )
+		img->pyramidStale.store( true, memory_order_relaxed );
 }
 
 /******************************************************************************\
@@ -261,7 +801,8 @@ void ImageType<pType>::setImageInfo(int rows, int cols, int levels)
 template <class pType>
 void ImageType<pType>::setPixelVal(int i, int j, pType val)
 {
-	pixelValue[i][j] = val;
+	markChanged();
+	pixelValue[(long)i*stride+j] = val;
 }
 
 /******************************************************************************\
@@ -270,11 +811,167 @@ void ImageType<pType>::setPixelVal(int i, int j, pType val)
 template <class pType>
 pType ImageType<pType>::getPixelVal(int i, int j) const
 {
-	return pixelValue[i][j];
+	return pixelValue[(long)i*stride+j];
+}
+
+/******************************************************************************\
+ returns a pointer to the first pixel of row i, the pixels may be written
+ through it so the pyramid is marked out of date
+\******************************************************************************/
+template <class pType>
+pType* ImageType<pType>::getRow(int i)
+{
+	markChanged();
+	return pixelValue + (long)i*stride;
+}
+
+template <class pType>
+const pType* ImageType<pType>::getRow(int i) const
+{
+	return pixelValue + (long)i*stride;
+}
+
+/******************************************************************************\
+ returns the distance in pixels between the start of two consecutive rows
+\******************************************************************************/
+template <class pType>
+int ImageType<pType>::getStride() const
+{
+	return stride;
 }
 
 /****************************Josh's functions**********************************/
 
+/******************************************************************************\
+ every level is rounded once, from the exact sums of its 2^k x 2^k blocks of
+ the image (rounding each level from the rounded one above would round the
+ same pixels again).  The sums of a level are the sums of 2x2 blocks of the
+ sums of the level above, so the image is only gone over once however many
+ levels are missing.  Levels already built are passed over but their sums are
+ still worked out
+\******************************************************************************/
+template <class pType>
+const ImageType<pType>& ImageType<pType>::pyramidLevel( int k ) const
+{
+	const int C = sizeof(wide) / sizeof(int);
+
+	if ( k < 0 )
+		throw (string)"Pyramid levels start at 0!";
+
+	if ( k == 0 )
+		return *this;
+
+	// the parent of a view can change its pixels without marking it
+	if ( pyramidStale.exchange( false ) || parent != NULL )
+		pyramid.clear();
+
+	if ( (int)pyramid.size() >= k )
+		return *pyramid[k-1];
+
+	if ( ( N >> k ) < 1 || ( M >> k ) < 1 )
+		throw (string)"Image is too small for that pyramid level!";
+
+	// C sums for every pixel of the level above, none for the image itself
+	vector<long long> above;
+	int rows = N, cols = M;
+
+	for ( int level = 1; level <= k; level++ )
+	{
+		const int n = rows / 2, m = cols / 2;
+		const bool keep = level > (int)pyramid.size();
+		vector<long long> sums( (long)n*m*C );
+
+		unique_ptr<ImageType<pType> > dst( keep ?
+		    new ImageType<pType>( n, m, Q, FILL_NONE ) : NULL );
+
+		parallelFor( n, 8, [&]( int first, int last )
+		{
+			const long long half = 1LL << ( 2*level - 1 );
+
+			for ( int i = first; i < last; i++ )
+			{
+				long long *sum = &sums[(long)i*m*C];
+				pType *out = keep ? dst->getRow(i) : NULL;
+
+				for ( int j = 0; j < m; j++, sum += C )
+				{
+					if ( level == 1 )
+					{
+						const pType *top = getRow( 2*i ) + 2*j;
+						const pType *bottom = getRow( 2*i + 1 ) + 2*j;
+						wide UL = traits::widen( top[0] );
+						wide UR = traits::widen( top[1] );
+						wide LL = traits::widen( bottom[0] );
+						wide LR = traits::widen( bottom[1] );
+						const int *ul = reinterpret_cast<const int*>( &UL );
+						const int *ur = reinterpret_cast<const int*>( &UR );
+						const int *ll = reinterpret_cast<const int*>( &LL );
+						const int *lr = reinterpret_cast<const int*>( &LR );
+
+						for ( int ch = 0; ch < C; ch++ )
+							sum[ch] = (long long)ul[ch] + ur[ch] + ll[ch] +
+							    lr[ch];
+					}
+					else
+					{
+						const long long *top =
+						    &above[( (long)( 2*i )*cols + 2*j )*C];
+						const long long *bottom = top + (long)cols*C;
+
+						for ( int ch = 0; ch < C; ch++ )
+							sum[ch] = top[ch] + top[C + ch] + bottom[ch] +
+							    bottom[C + ch];
+					}
+
+					if ( keep )
+					{
+						wide result;
+						int *avg = reinterpret_cast<int*>( &result );
+
+						// rounded half up like SummedAreaTable::areaMean
+						for ( int ch = 0; ch < C; ch++ )
+							avg[ch] = (int)( ( sum[ch] + half ) >>
+							    ( 2*level ) );
+
+						out[j] = traits::narrow( result );
+					}
+				}
+			}
+		} );
+
+		if ( keep )
+			pyramid.push_back( move( dst ) );
+
+		above.swap( sums );
+		rows = n;
+		cols = m;
+	}
+
+	return *pyramid[k-1];
+}
+
+template <class pType>
+int ImageType<pType>::pyramidLevelFor( int rows, int cols ) const
+{
+	int k = 0;
+
+	if ( rows <= 0 || cols <= 0 )
+		return 0;
+
+	while ( k < 30 && N % ( 2 << k ) == 0 && M % ( 2 << k ) == 0 &&
+	        ( N >> ( k+1 ) ) >= rows && ( M >> ( k+1 ) ) >= cols )
+		k++;
+
+	return ( N >> k ) == rows && ( M >> k ) == cols ? k : 0;
+}
+
+template <class pType>
+void ImageType<pType>::dropPyramid()
+{
+	pyramid.clear();
+	pyramidStale = false;
+}
+
 /******************************************************************************\
  this calculates the average gray value in the picture, this is done by adding
  all of the pixels and dividing by the total number of pixels
@@ -282,24 +979,56 @@ pType ImageType<pType>::getPixelVal(int i, int j) const
 template <class pType>
 pType ImageType<pType>::meanColor() const
 {
-	pType total;
+	const int C = traits::color ? 3 : 1;
+	SampleStats stats[3];
+	wide total;
+	int *level = reinterpret_cast<int*>( &total );
 
-	total = 0;
-	
-	// sum the gray values
-	for ( int i = 0; i < N; i++ )
-		for ( int j = 0; j < M; j++ )
-			total += pixelValue[i][j];
+	// the sums are 64 bit so no image is too big, an empty one gives 0
+	statistics( stats );
+
+	for ( int c = 0; c < C; c++ )
+		level[c] = stats[c].intMean();
+
+	return traits::narrow( total );
+}
 
-	// return 0 if there are no pixels, otherwise divide gray by total pixels
-	if ( M*N == 0 )
+/******************************************************************************\
+ every row is reduced by the vector kernel on its own into a slot of its own,
+ so threads never share a total and the result doesn't depend on how many
+ there are
+\******************************************************************************/
+template <class pType>
+void ImageType<pType>::statistics( SampleStats stats[] ) const
+{
+	typedef typename traits::channel channel;
+	const int C = traits::color ? 3 : 1;
+
+	reduceRows( stats, [&]( const pType *row, SampleStats *rowStats )
 	{
-		total = 0;
-	} else
+		reduceSamples( reinterpret_cast<const channel*>( row ), (long)M * C,
+		    C, rowStats );
+	} );
+}
+
+template <class pType>
+template <class RowFunc>
+void ImageType<pType>::reduceRows( SampleStats stats[],
+	const RowFunc& func ) const
+{
+	const int C = traits::color ? 3 : 1;
+	vector<SampleStats> rows( (long)max( N, 1 ) * C );
+
+	parallelFor( N, 64, [&]( int first, int last )
 	{
-		total = total/(M*N);
-	}
-	return total;
+		for ( int i = first; i < last; i++ )
+			func( getRow(i), &rows[(long)i * C] );
+	} );
+
+	addPairwise( &rows[0], N, C );
+
+	for ( int c = 0; c < C; c++ )
+		stats[c] = rows[c];
 }
 
 /******************************************************************************\
@@ -316,153 +1045,89 @@ void ImageType<pType>::enlargeImage( int S, const ImageType<pType>& old )
  This function enlarges an image by a magnitude of s, so for example if the
  original function was 100x100 and s is 10, then the new image is 1000x1000
 
- The method I choose to use was bicubic/linear interpolation which creates
- splines for each column(cubic or linear), then using those splines create an
- image which is a stretched version of the original image.  The way I achieved
- this was to stretch the entire image only vertically, and then stretch that
- image horizontally.  I did the same thing except reversed (stretched image
- horizontally first) and then summed the two images together.  This gives an
- average value between both methods.  Although it can handle S values less
- than 1, the shrinkImage function works better for this.
-
- if cubic = true then use cubic interpolation
- if cubic = false then use linear interpolation
+ The image is stretched with natural cubic splines, first along every row and
+ then down every column.  The spline through a row or column is a weighted sum
+ of its pixels, so the weights for each output row and column are worked out
+ once by a Resampler (one for each direction) instead of building a new
+ spline for every row and column.  The columns are stretched a whole row at a
+ time so the image is always walked along its rows.  Only the horizontally
+ stretched image (the height of old) and its spline derivatives are held in
+ between.  Although it can handle S values less than 1, the shrinkImage
+ function works better for this.
 \******************************************************************************/
 template <class pType>
 void ImageType<pType>::enlargeImage( double S, const ImageType<pType>& old )
 {
 	// check parameters
 	if ( old.M < 4 || old.N < 4 )
-		// force linear if less than 4 height or width
 		throw (string)"Image too small to enlarge, must be at least 3x3";
 
+	// a wide value is one int for each channel
+	const int C = sizeof(wide) / sizeof(int);
 
-	// slightly modify S to make it a better value for spline
-	double Shoriz = (double)((int)(old.M*S))/old.M;
-	double Svert = (double)((int)(old.N*S))/old.N;
-	
-	pType colorVal;	// used to hold the calculated color value
-	double splineX; // the x value passed to the spline function
-
-	pType *horizVals = new pType[old.M];	// holds points for spline
-	pType *vertVals = new pType[old.N];		// holds points for spline
-
-	// temporary images used to stretch before 2nd interpolation
-	ImageType horiz, vert, half1, half2;
+	// set the new image to the new size, every pixel is calculated below
+	setImageInfo( old.N * S, old.M * S, old.Q, FILL_NONE );
 
-	// this is the spline object used to store the spline values
-	cubicSpline spline;
+	Resampler horiz( old.M, M ), vert( old.N, N );
 
-	// set the new image to the
-	setImageInfo( old.N * S, old.M * S, old.Q );
+	long inWidth = (long)old.M * C;
+	long outWidth = (long)M * C;
 
-	// set temp to a stretched horizontally only
-	horiz.setImageInfo( old.N, M, Q );
-	vert.setImageInfo( N, old.M, Q );
-	half1.setImageInfo( N, M, Q );
-	half2.setImageInfo( N, M, Q );
+	// old stretched horizontally only, and the second derivatives of the
+	// splines down its columns
+	vector<double> mid( old.N * outWidth ), midDeriv( old.N * outWidth );
 
-	// stretch old image vertiacally and store in vert
-	for ( int col = 0; col < old.M; col++ )
+	// stretch every row of old, each band of rows has its own row of samples
+	// and derivatives and its own row of pixels
+	parallelFor( old.N, 16, [&]( int first, int last )
 	{
-		// get the values used to create the spline for the column
-		for ( int row = 0; row < old.N; row++ )
-			vertVals[row] = old.pixelValue[row][col];
-
-		// actually create the spline (assumed the pixels are equally spaced)
-		spline.create( vertVals, old.N );
+		vector<double> vals( inWidth ), deriv( inWidth );
+		vector<wide> pixels( old.M );
+		int *channels = reinterpret_cast<int*>( &pixels[0] );
 
-		// using the spline set the values of vert
-		for ( int row = 0; row < N; row++ )
+		for ( int row = first; row < last; row++ )
 		{
-			// value to pull from spline for current row
-			splineX = (row-Svert/2.0)/(N-Svert-1.0) * 100.0;
-			
-			spline.getVal(splineX, colorVal);
-			
-			// NOTE: don't clip values yet, it causes problems...
-
-			vert.pixelValue[row][col] = colorVal;
-		}
-	}
+			const pType *src = old.getRow(row);
+			double *dst = &mid[row * outWidth];
 
-	// now stretch vert horizontally and store in half1
-	for ( int row = 0; row < N; row++ )
-	{
-		// get the values used to create the spline for the row
-		for ( int col = 0; col < old.M; col++ )
-			horizVals[col] = vert.pixelValue[row][col];
+			for ( int col = 0; col < old.M; col++ )
+				pixels[col] = traits::widen( src[col] );
+			for ( long k = 0; k < inWidth; k++ )
+				vals[k] = channels[k];
 
-		// actually create the spline (cubic if parameter is true)
-		spline.create( horizVals, old.M );
+			horiz.solve( &vals[0], &deriv[0], C );
 
-		// using the spline set the values
-		for ( int col = 0 ; col < M; col++ )
-		{
-			splineX = (col-Shoriz/2.0)/(M-Shoriz-1.0) * 100.0;
-			
-			// obtain new color from spline value
-			spline.getVal(splineX, colorVal);
-			
-			// set the pixel value for half1
-			half1.pixelValue[row][col] = colorVal;
+			for ( int col = 0; col < M; col++ )
+				horiz.evaluate( &vals[0], &deriv[0], C, col, dst + col*C );
 		}
-	}
+	} );
 
-	// stretch old image horizontally and store in horiz
-	for ( int row = 0; row < old.N; row++ )
+	// then stretch all of the columns together, a row at a time.  The
+	// columns are independent so they are solved in bands of columns
+	parallelFor( (int)outWidth, 256, [&]( int first, int last )
 	{
-		// get the values used to create the spline for the row
-		for ( int col = 0; col < old.M; col++ )
-			horizVals[col] = old.pixelValue[row][col];
-
-		// actually create the spline (assumed the pixels are equally spaced)
-		spline.create( horizVals, old.M );
+		vert.solve( &mid[0], &midDeriv[0], outWidth, first, last );
+	} );
 
-		// using the spline set the values of temp
-		for ( int col = 0; col < M; col++ )
-		{
-			// value to pull from spline for current col
-			splineX = (col-Shoriz/2.0)/(M-Shoriz-1.0) * 100.0;
-			
-			// obtain new color from spline value
-			spline.getVal(splineX, colorVal);
-			
-			// NOTE: don't clip values yet, it causes problems...
-
-			horiz.pixelValue[row][col] = colorVal;
-		}
-	}
-
-	// now stretch horiz vertically and store in half2
-	for ( int col = 0; col < M; col++ )
+	parallelFor( N, 16, [&]( int first, int last )
 	{
-		// get the values used to create the spline for the column
-		for ( int row = 0; row < old.N; row++ )
-			vertVals[row] = horiz.pixelValue[row][col];
+		vector<double> vals( outWidth );
+		vector<wide> pixels( M );
+		int *channels = reinterpret_cast<int*>( &pixels[0] );
 
-		// actually create the spline (cubic if parameter is true)
-		spline.create( vertVals, old.N );
-
-		// using the spline set the values
-		for ( int row = 0 ; row < N; row++ )
+		for ( int row = first; row < last; row++ )
 		{
-			splineX = (row-Svert/2.0)/(N-Svert-1.0) * 100.0;
-			
-			// obtain new color from spline value
-			spline.getVal(splineX, colorVal);
-			
-			// set the value of half2
-			half2.pixelValue[row][col] = colorVal;
-		}
-	}
+			pType *dst = getRow(row);
 
-	// sum half1 and half2 to get the average value everywhere
-	*this = half1 + half2;
+			vert.evaluate( &mid[0], &midDeriv[0], outWidth, row, &vals[0] );
 
-	// de-allocate all that memory
-	delete [] horizVals;
-	delete [] vertVals;
+			// values are only saturated to the pixel type here at the end
+			for ( long k = 0; k < outWidth; k++ )
+				channels[k] = (int)vals[k];
+			for ( int col = 0; col < M; col++ )
+				dst[col] = traits::narrow( pixels[col] );
+		}
+	} );
 }
 
 /******************************************************************************\
@@ -474,15 +1139,21 @@ template <class pType>
 void ImageType<pType>::reflectImage( bool flag, const ImageType<pType>& old )
 {
 	// set image info same as old's
-	setImageInfo( old.N, old.M, old.Q );
+	setImageInfo( old.N, old.M, old.Q, FILL_NONE );
 
 	// if flag is set copy opposite row, if not copy opposite column
 	for ( int i = 0; i < N; i++ )
-		for ( int j = 0; j < M; j++ )
-			if ( flag )
-				pixelValue[i][j] = old.pixelValue[i][M-j-1];
-			else
-				pixelValue[i][j] = old.pixelValue[N-i-1][j];
+	{
+		pType *dst = getRow(i);
+		const pType *src = old.getRow( flag ? i : N-i-1 );
+
+		if ( flag )
+			for ( int j = 0; j < M; j++ )
+				dst[j] = src[M-j-1];
+		else
+			for ( int j = 0; j < M; j++ )
+				dst[j] = src[j];
+	}
 }
 
 /******************************************************************************\
@@ -499,18 +1170,23 @@ ImageType<pType>& ImageType<pType>::operator- ( const ImageType<pType>& rhs )
 		throw (string)"Images do not have the same dimensions!";
 
 	for ( int i = 0; i < N; i++ )
+	{
+		pType *dst = getRow(i);
+		const pType *src = rhs.getRow(i);
 		for ( int j = 0; j < M; j++ )
 		{
 			// calculate subtracted value
-			pixelValue[i][j] = abs(pixelValue[i][j] - rhs.pixelValue[i][j]);
+			wide diff = abs( traits::widen(dst[j]) -
+			    traits::widen(src[j]) );
 
 			// if pixels are less than Q/6 different then make them black
 			// this helps prevent noise
-			if ( pixelValue[i][j] < Q/6 )
-				pixelValue[i][j] = 0;
+			if ( diff < Q/6 )
+				dst[j] = 0;
 			else
-				pixelValue[i][j] = Q;
+				dst[j] = Q;
 		}
+	}
 	return *this;	// return current object
 }
 
@@ -521,13 +1197,34 @@ ImageType<pType>& ImageType<pType>::operator- ( const ImageType<pType>& rhs )
 template <class pType>
 void ImageType<pType>::negateImage()
 {
-	// calculate the negative of each pixel
-	for ( int i = 0; i < N; i++ )
-		for ( int j = 0; j < M; j++ )
-		{
-			pixelValue[i][j] = pixelValue[i][j] - Q;
-			pixelValue[i][j] = pixelValue[i][j] * (-1);
-		}
+	applyMap( PointMap::negate( Q, traits::color ? 3 : 1 ) );
+}
+
+template <class pType>
+void ImageType<pType>::applyMap( const PointMap& map )
+{
+	if ( map.getLevels() != Q )
+		throw (string)"Point map doesn't match the image!";
+
+	RowMap<pType> rows( map );
+
+	parallelFor( N, 16, [&]( int first, int last )
+	{
+		for ( int i = first; i < last; i++ )
+			rows.apply( getRow(i), M );
+	} );
+}
+
+template <class pType>
+void ImageType<pType>::gammaImage( double gamma )
+{
+	applyMap( PointMap::gamma( Q, traits::color ? 3 : 1, gamma ) );
+}
+
+template <class pType>
+void ImageType<pType>::stretchImage( int low, int high )
+{
+	applyMap( PointMap::stretch( Q, traits::color ? 3 : 1, low, high ) );
 }
 
 /*****************************Josiah's functions*******************************/
@@ -548,45 +1245,193 @@ void ImageType<pType>::getSubImage( int ULr, int ULc, int LRr, int LRc,
 	width = abs(ULc - LRc);
  
 	// make a new array for the exact size of the new subimage
-	setImageInfo(height, width, old.Q);
+	setImageInfo(height, width, old.Q, FILL_NONE);
   
 	// copy over the old stuff into the new subimage array
-	for(int i = 0; i < N; i++)
+	for(int i = 0; i < N; i++) {
+		pType *dst = getRow(i);
+		const pType *src = old.getRow(ULr+i) + ULc;
 		for(int j = 0; j < M; j++)
-			pixelValue[i][j] = old.pixelValue[ULr+i][ULc+j];
+			dst[j] = src[j];
+	}
 }
 
 /******************************************************************************\
- Shrink image, average all the values in the block to make the new pixel, this
- makes the shrink much less jagged looking in the end
+ Resample with a filter kernel.  The weights of every output row and column
+ come from the shared cache in filterKernel.h, so resampling many images of
+ the same size works them out once.  Rows are done first into a buffer of
+ doubles the height of old, then every output row is a weighted sum of whole
+ rows of that buffer
 \******************************************************************************/
 template <class pType>
-void ImageType<pType>::shrinkImage( int s, const ImageType<pType>& old )
+void ImageType<pType>::resampleImage( int rows, int cols,
+	const ImageType<pType>& old, int filter )
 {
-	// used to find average pixel value
-	pType total;
-	int num;
+	const int C = sizeof(wide) / sizeof(int);
 
-    // make new array with correct size
-	setImageInfo(old.N / s, old.M / s, old.Q);
+	// the result can't be written over its own source
+	if ( this == &old )
+	{
+		ImageType<pType> copy( old );
+		resampleImage( rows, cols, copy, filter );
+		return;
+	}
 
-	// copy over every s pixel
-	for(int i = 0; i < N; i++)
-		for(int j = 0; j < M; j++) {
-			// reset values for averaging
-			total = 0;
-			num = 0;
+	if ( rows < 1 || cols < 1 )
+		throw (string)"Resampled image must be at least 1x1!";
 
-			// sum the total value of pixels in the row/col
-			for ( int row = i*s; row < (i+1)*s; row++ )
-				for ( int col = j*s; col < (j+1)*s; col++ ) {
-					total += old.pixelValue[row][col];
-					num++;
-				}
+	shared_ptr<const FilterWeights> horiz = getFilterWeights( filter, old.M,
+	    cols );
+	shared_ptr<const FilterWeights> vert = getFilterWeights( filter, old.N,
+	    rows );
+
+	long width = (long)cols * C;
+	vector<double> mid( old.N * width );
+
+	parallelFor( old.N, 8, [&]( int first, int last )
+	{
+		vector<double> in( (long)old.M * C );
+
+		for ( int i = first; i < last; i++ )
+		{
+			const pType *src = old.getRow(i);
+
+			for ( int j = 0; j < old.M; j++ )
+			{
+				wide v = traits::widen( src[j] );
+				const int *ch = reinterpret_cast<const int*>( &v );
+
+				for ( int k = 0; k < C; k++ )
+					in[(long)j*C + k] = ch[k];
+			}
+
+			for ( int k = 0; k < cols; k++ )
+				horiz->apply( &in[0], C, k, &mid[i*width + (long)k*C] );
+		}
+	} );
+
+	setImageInfo( rows, cols, old.Q, FILL_NONE );
+
+	parallelFor( N, 8, [&]( int first, int last )
+	{
+		vector<double> out( width );
+
+		for ( int i = first; i < last; i++ )
+		{
+			pType *dst = getRow(i);
+
+			vert->apply( &mid[0], width, i, &out[0] );
+
+			for ( int j = 0; j < M; j++ )
+				dst[j] = roundPixel( &out[(long)j*C], Q );
+		}
+	} );
+}
+
+template <class pType>
+void ImageType<pType>::enlargeImage( double S, const ImageType<pType>& old,
+	int filter )
+{
+	resampleImage( old.N * S, old.M * S, old, filter );
+}
+
+template <class pType>
+void ImageType<pType>::shrinkImage( double s, const ImageType<pType>& old,
+	int filter )
+{
+	if ( !( s > 0 ) )
+		throw (string)"Shrink factor must be more than 0!";
+
+	resampleImage( max( (int)( old.N / s ), 1 ), max( (int)( old.M / s ), 1 ),
+	    old, filter );
+}
+
+/******************************************************************************\
+ Shrink image, average all the values in the block to make the new pixel, this
+ makes the shrink much less jagged looking in the end.  The blocks are spread
+ evenly over the whole of old, so rows and columns left over when s doesn't
+ divide the size aren't dropped (with s = N/rows exactly a block is s x s).
+ Each block's average comes from old's summed area table, which weighs pixels
+ cut by a block's edge by how much of them it covers and costs the same for
+ any s.  When the blocks are exactly the 2^k x 2^k blocks of a pyramid level
+ the level is copied, so shrinking the same image by several powers of two
+ only goes over the full image once.  Any other shrink averages the image
+ itself, averaging a level would round the pixels twice
+\******************************************************************************/
+template <class pType>
+void ImageType<pType>::shrinkImage( double s, const ImageType<pType>& old )
+{
+	int oldN = old.N, oldM = old.M, oldQ = old.Q;
+
+	if ( !( s > 0 ) )
+		throw (string)"Shrink factor must be more than 0!";
+
+	// make new array with correct size, never less than one pixel
+	int rows = max( (int)( oldN / s ), 1 ), cols = max( (int)( oldM / s ), 1 );
+	int k = old.pyramidLevelFor( rows, cols );
+
+	// old may be this image, so the level is copied before this is resized,
+	// and a view is written to like any other shrink
+	if ( k > 0 )
+	{
+		ImageType<pType> level( old.pyramidLevel( k ) );
+
+		setImageInfo( rows, cols, oldQ, FILL_NONE );
+		takeResult( level );
+		return;
+	}
 
-			// set the new pixel value
-			pixelValue[i][j] = total/num;
+	// old isn't needed again once the table is built
+	SummedAreaTable<pType> table( old );
+
+	setImageInfo( rows, cols, oldQ, FILL_NONE );
+
+	// size of a block in old
+	double rowStep = (double)oldN / N;
+	double colStep = (double)oldM / M;
+
+	parallelFor( N, 8, [&]( int first, int last )
+	{
+		for ( int i = first; i < last; i++ )
+		{
+			pType *dst = getRow(i);
+
+			for ( int j = 0; j < M; j++ )
+				dst[j] = traits::narrow( table.areaMean( i*rowStep,
+				    j*colStep, ( i+1 )*rowStep, ( j+1 )*colStep ) );
+		}
+	} );
+}
+
+template <class pType>
+void ImageType<pType>::boxFilter( int r, const ImageType<pType>& old )
+{
+	if ( r < 0 )
+		throw (string)"Box filter radius can't be negative!";
+
+	SummedAreaTable<pType> table( old );
+	ImageType<pType> temp( old.N, old.M, old.Q, FILL_NONE );
+
+	parallelFor( temp.N, 8, [&]( int first, int last )
+	{
+		for ( int i = first; i < last; i++ )
+		{
+			pType *dst = temp.getRow(i);
+
+			for ( int j = 0; j < temp.M; j++ )
+				dst[j] = traits::narrow(
+				    table.mean( i-r, j-r, i+r+1, j+r+1 ) );
 		}
+	} );
+
+	// a view of the same size is written in place
+	if ( N == old.N && M == old.M )
+	{
+		takeResult( temp );
+		Q = old.Q;
+	}
+	else
+		swap( temp );
 }
 
 /******************************************************************************\
@@ -596,14 +1441,17 @@ void ImageType<pType>::shrinkImage( int s, const ImageType<pType>& old )
 template <class pType>
 void ImageType<pType>::translateImage( int t, const ImageType<pType>& old )
 {
-	//make this image's image array
-	setImageInfo(old.N, old.M, old.Q);
+	//make this image's image array, the uncovered part shows the background
+	setImageInfo(old.N, old.M, old.Q, FILL_BACKGROUND);
 
 	// count backwards through to the newly defined upper left corner copying
 	// from everywhere before
-	for(int i = N - 1; i >= 0 + t; i--)
+	for(int i = N - 1; i >= 0 + t; i--) {
+		pType *dst = getRow(i);
+		const pType *src = old.getRow(i-t);
 		for(int j = M - 1; j >= 0 + t; j--)
-			pixelValue[i][j] = old.pixelValue[i-t][j-t];
+			dst[j] = src[j-t];
+	}
 }
 
 /******************************************************************************\
@@ -613,113 +1461,652 @@ void ImageType<pType>::translateImage( int t, const ImageType<pType>& old )
  is determined the surrounding pixels are used to calculate intermediate values
  between the pixels, this gives a pretty smooth rotate.
 
+ The source location is a linear function of the row and column, so it is
+ handed to sampleMapped as two sets of coefficients.  Multiples of 90 degrees
+ use exact sines and cosines, when those land on whole pixels (always for 180,
+ and for 90 and 270 when N and M are both even or both odd) the rotation is
+ just a copy.
+
  - Originally written by Josiah, modified with Joshua's help
 \******************************************************************************/
 template <class pType>
 void ImageType<pType>::rotateImage( int theta, const ImageType<pType>& old )
 {
+	double rowMap[3], colMap[3];
+
+	// set image to correct size, corners not covered show the background
+	setImageInfo(old.N, old.M, old.Q, FILL_BACKGROUND);
+
+	if ( rotationMap( theta, rowMap, colMap ) )
+	{
+		int rows[3] = { (int)rowMap[0], (int)rowMap[1], (int)rowMap[2] };
+		int cols[3] = { (int)colMap[0], (int)colMap[1], (int)colMap[2] };
+
+		copyMapped( old, rows, cols, 1 );
+	}
+	else
+		sampleMapped( old, rowMap, colMap, 1 );
+}
+
+/******************************************************************************\
+ the same rotation with a filter.  Whole pixel maps are still a copy as long
+ as the filter gives back a pixel when sampled right on it (all the built in
+ ones but mitchell)
+\******************************************************************************/
+template <class pType>
+void ImageType<pType>::rotateImage( int theta, const ImageType<pType>& old,
+	int filter )
+{
+	double rowMap[3], colMap[3];
+	shared_ptr<const PhaseWeights> taps = getPhaseWeights( filter );
+
+	setImageInfo(old.N, old.M, old.Q, FILL_BACKGROUND);
+
+	if ( rotationMap( theta, rowMap, colMap ) &&
+	     taps->taps( 0 )[taps->first()] == 1 )
+	{
+		int rows[3] = { (int)rowMap[0], (int)rowMap[1], (int)rowMap[2] };
+		int cols[3] = { (int)colMap[0], (int)colMap[1], (int)colMap[2] };
+
+		copyMapped( old, rows, cols, 1 );
+	}
+	else
+		sampleFiltered( old, rowMap, colMap, filter );
+}
+
+template <class pType>
+bool ImageType<pType>::rotationMap( int theta, double rowMap[3],
+	double colMap[3] ) const
+{
+	// exact values for 0, 90, 180 and 270 degrees
+	static const int quarterCos[4] = { 1, 0, -1, 0 };
+	static const int quarterSin[4] = { 0, 1, 0, -1 };
+
 	// reverse theta to make a counter-clockwise rotation
 	theta *= -1;
 
-	// set image to correct size
-	setImageInfo(old.N, old.M, old.Q);
-	pType final;	// holds final color value for given location
-	
-	// holds various color values
-	pType UL, UR, LL, LR, U, D, L, R, Hval, Vval;
+	double cosT, sinT;
+	int angle = ( theta % 360 + 360 ) % 360;
+
+	if ( angle % 90 == 0 )
+	{
+		cosT = quarterCos[angle / 90];
+		sinT = quarterSin[angle / 90];
+	}
+	else
+	{
+		// 4 * atan(1) = pi
+		double rad = theta * 4 * atan(1.0)/180;
+		cosT = cos(rad);
+		sinT = sin(rad);
+	}
+
+	// middle row, middle column
+	double r_0 = N/2.0;
+	double c_0 = M/2.0;
+
+	// pixel (i,j) comes from
+	//   r = r_0 + (i-r_0)*cos - (j-c_0)*sin
+	//   c = c_0 + (i-r_0)*sin + (j-c_0)*cos
+	rowMap[0] = r_0 - r_0*cosT + c_0*sinT;
+	rowMap[1] = cosT;
+	rowMap[2] = -sinT;
+	colMap[0] = c_0 - r_0*sinT - c_0*cosT;
+	colMap[1] = sinT;
+	colMap[2] = cosT;
+
+	return angle % 90 == 0 && rowMap[0] == floor( rowMap[0] ) &&
+	    colMap[0] == floor( colMap[0] );
+}
+
+/******************************************************************************\
+ the taps for each direction come from the filter's phase table, so sampling
+ a position is two lookups and a small 2d dot product
+\******************************************************************************/
+template <class pType>
+void ImageType<pType>::sampleFiltered( const ImageType<pType>& old,
+	const double rowMap[3], const double colMap[3], int filter )
+{
+	const int C = sizeof(wide) / sizeof(int);
+	shared_ptr<const PhaseWeights> weights = getPhaseWeights( filter );
+	int n = weights->size(), offset = weights->first();
 
-	// holds the slopes between different points
-	pType USlope, DSlope, LSlope, RSlope, HSlope, VSlope;
+	parallelFor( N, 8, [&]( int first, int last )
+	{
+		vector<int> rows( n ), cols( n );
+		vector<double> across( n * C );
 
-	// 4 * atan(1) = pi
-	float rad = theta * 4 * atan(1.0)/180;
+		for ( int i = first; i < last; i++ )
+		{
+			pType *dst = getRow(i);
 
-	// row, column, middle row, middle column
-	double r, c, r_0, c_0;
+			for ( int j = 0; j < M; j++ )
+			{
+				double r = rowMap[0] + rowMap[1]*i + rowMap[2]*j;
+				double c = colMap[0] + colMap[1]*i + colMap[2]*j;
 
-	// set middle values
-	r_0 = N/2.0;
-	c_0 = M/2.0;
+				if ( !( r > 0 && r < old.N && c > 0 && c < old.M ) )
+					continue;	// no value here, retain background
 
-	// loops through entire picture, going from dest, to source to prev holes
-	for(int i = 0; i < N; i++){
-		for(int j = 0; j < M; j++){
-			// calculate where the original value should be
-			r = r_0 + (i-r_0)*cos(rad) - (j-c_0)*sin(rad);
-			c = c_0 + (i-r_0)*sin(rad) + (j-c_0)*cos(rad);
+				int r0 = (int)r, c0 = (int)c;
+				const double *wr = weights->taps( r - r0 );
+				const double *wc = weights->taps( c - c0 );
+				double sum[C];
 
-			// old method
-			/*if ( r < N && r >= 0 && c < M && c >= 0 )
-				final = old.pixelValue[(int)r][(int)c];
-			else
-				final = pixelValue[i][j];*/
-
-			// only draw a pixel if source value is in range
-			if ( r > 0 && ceil(r) < N && c > 0 && ceil(c) < M ) {
-
-				// get four pixel value which surround the desired value
-				UL = old.pixelValue[(int)r][(int)c];
-				UR = old.pixelValue[(int)r][(int)ceil(c)];
-				LL = old.pixelValue[(int)ceil(r)][(int)c];
-				LR = old.pixelValue[(int)ceil(r)][(int)ceil(c)];
-
-				// find the slope of the line between all four corners
-				USlope = UR - UL;
-				DSlope = LR - LL;
-				LSlope = LL - UL; 
-				RSlope = LR - UR;
-	
-				// get the intermediate value corresponding with desired r/c val
-				U = UL + USlope*(c-(int)c);
-				D = LL + DSlope*(c-(int)c);
-				L = UL + LSlope*(r-(int)r);
-				R = UR + RSlope*(r-(int)r);
-
-				// get the slop between intermediate values
-				HSlope = D - U;
-				VSlope = R - L;
-
-				// find 2 different color estimations of the desired pixel
-				Hval = U + HSlope*(r-(int)r);
-				Vval = L + VSlope*(c-(int)c);
-
-				// average the estimations
-				final = (Hval + Vval) / 2;
+				for ( int t = 0; t < n; t++ )
+				{
+					rows[t] = min( max( r0 - offset + t, 0 ), old.N - 1 );
+					cols[t] = min( max( c0 - offset + t, 0 ), old.M - 1 );
+				}
+
+				for ( int ch = 0; ch < C; ch++ )
+					sum[ch] = 0;
+
+				// each row of taps blended across, then the rows blended
+				for ( int y = 0; y < n; y++ )
+				{
+					const pType *src = old.getRow( rows[y] );
+					double *row = &across[y*C];
+
+					for ( int ch = 0; ch < C; ch++ )
+						row[ch] = 0;
+
+					for ( int x = 0; x < n; x++ )
+					{
+						wide v = traits::widen( src[cols[x]] );
+						const int *in = reinterpret_cast<const int*>( &v );
+
+						for ( int ch = 0; ch < C; ch++ )
+							row[ch] += wc[x]*in[ch];
+					}
+
+					for ( int ch = 0; ch < C; ch++ )
+						sum[ch] += wr[y]*row[ch];
+				}
+
+				dst[j] = roundPixel( sum, old.Q );
 			}
-			else if ( r > 0 && ceil(r) < N && c > 0 && c < M ) { // right edge
-				// get upper and lower value
-				UL = old.pixelValue[(int)r][(int)c];
-				LL = old.pixelValue[(int)ceil(r)][(int)c];
+		}
+	} );
+}
+
+template <class pType>
+pType ImageType<pType>::roundPixel( const double value[], int levels )
+{
+	const int C = sizeof(wide) / sizeof(int);
+	wide result;
+	int *out = reinterpret_cast<int*>( &result );
+
+	for ( int ch = 0; ch < C; ch++ )
+		out[ch] = (int)min( max( floor( value[ch] + 0.5 ), 0.0 ),
+		    (double)levels );
+
+	return traits::narrow( result );
+}
+
+/******************************************************************************\
+ Warp the image through a transform, which maps positions in old to positions
+ in this image.  Like the rotation it works backwards, each pixel of this
+ image is sampled from old at the position the inverse transform gives it, so
+ however many transforms went into the matrix old is only resampled once.
+
+ An affine inverse moves the source position by the same amount every column,
+ so bilinear warps walk it across each row with sampleMapped and warps that
+ land on whole pixels (shifts, flips and quarter turns) are straight copies.
+ Everything else (perspective, nearest and bicubic) is sampled one position
+ at a time by samplePoints.  Unlike the rotation, row and column 0 of old are
+ inside, so the identity gives back old exactly
+\******************************************************************************/
+template <class pType>
+void ImageType<pType>::warpAffine( const Transform& t,
+	const ImageType<pType>& old, SampleType sample, int rows, int cols )
+{
+	if ( !t.isAffine() )
+		throw (string)"warpAffine needs an affine transform!";
+
+	warpPerspective( t, old, sample, rows, cols );
+}
+
+template <class pType>
+void ImageType<pType>::warpPerspective( const Transform& t,
+	const ImageType<pType>& old, SampleType sample, int rows, int cols )
+{
+	// the result can't be written over its own source
+	if ( this == &old )
+	{
+		ImageType<pType> copy( old );
+		warpPerspective( t, copy, sample, rows, cols );
+		return;
+	}
+
+	if ( rows < 0 || cols < 0 )
+		throw (string)"Warped image can't have a negative size!";
+
+	Transform inv = t.inverse();
+
+	setImageInfo( rows ? rows : old.N, cols ? cols : old.M, old.Q,
+	    FILL_BACKGROUND );
+
+	if ( !inv.isAffine() )
+	{
+		samplePoints( old, inv, sample );
+		return;
+	}
+
+	// pixel (i,j) comes from
+	//   r = inv[0][2] + inv[0][0]*i + inv[0][1]*j
+	//   c = inv[1][2] + inv[1][0]*i + inv[1][1]*j
+	double rowMap[3] = { inv.m[0][2], inv.m[0][0], inv.m[0][1] };
+	double colMap[3] = { inv.m[1][2], inv.m[1][0], inv.m[1][1] };
+	bool whole = fabs( rowMap[2] ) <= 1 && fabs( colMap[2] ) <= 1;
+
+	for ( int k = 0; k < 3; k++ )
+		whole = whole && rowMap[k] == floor( rowMap[k] ) &&
+		    colMap[k] == floor( colMap[k] ) &&
+		    fabs( rowMap[k] ) < INT_MAX/4 && fabs( colMap[k] ) < INT_MAX/4;
 
-				// find slope between two values
-				LSlope = LL - UL;
+	// every filter gives back the pixel itself on a whole pixel
+	if ( whole )
+	{
+		int rowSteps[3] = { (int)rowMap[0], (int)rowMap[1], (int)rowMap[2] };
+		int colSteps[3] = { (int)colMap[0], (int)colMap[1], (int)colMap[2] };
 
-				// get value of final point
-				final = UL + LSlope*(r-(int)r);
+		copyMapped( old, rowSteps, colSteps, 0 );
+	}
+	else if ( sample == SAMPLE_BILINEAR )
+		sampleMapped( old, rowMap, colMap, 0 );
+	else
+		samplePoints( old, inv, sample );
+}
+
+/******************************************************************************\
+ the homogeneous source position is a linear function of the column, it is
+ worked out from the start of the row each time (no error builds up) and
+ divided through by w.  Positions with w <= 0 are behind the viewer of a
+ perspective transform and show the background
+\******************************************************************************/
+template <class pType>
+void ImageType<pType>::samplePoints( const ImageType<pType>& old,
+	const Transform& inv, SampleType sample )
+{
+	parallelFor( N, 8, [&]( int first, int last )
+	{
+		for ( int i = first; i < last; i++ )
+		{
+			pType *dst = getRow(i);
+			double r = inv.m[0][0]*i + inv.m[0][2];
+			double c = inv.m[1][0]*i + inv.m[1][2];
+			double w = inv.m[2][0]*i + inv.m[2][2];
+
+			for ( int j = 0; j < M; j++ )
+			{
+				double wj = w + inv.m[2][1]*j;
+
+				if ( wj > 0 )
+					samplePoint( old, ( r + inv.m[0][1]*j ) / wj,
+					    ( c + inv.m[1][1]*j ) / wj, sample, dst[j] );
 			}
-			else if ( r > 0 && r < N && c > 0 && ceil(c) < M ) { // bottom edge
-				// get left and right values
-				UL = old.pixelValue[(int)r][(int)c];
-				UR = old.pixelValue[(int)r][(int)ceil(c)];
+		}
+	} );
+}
 
-				// find slope between two values
-				USlope = UR - UL;
+/******************************************************************************\
+ a position is inside old when 0 <= r < N and 0 <= c < M for every filter.
+ Bilinear goes through the same edge rules as sampleMapped, bicubic clamps
+ the pixels it reaches for past the edges and clips its overshoot to the
+ image's levels
+\******************************************************************************/
+template <class pType>
+void ImageType<pType>::samplePoint( const ImageType<pType>& old, double r,
+	double c, SampleType sample, pType& dst ) const
+{
+	const int C = sizeof(wide) / sizeof(int);
+
+	// written so NaN is outside as well
+	if ( !( r >= 0 && r < old.N && c >= 0 && c < old.M ) )
+		return;
+
+	if ( sample == SAMPLE_NEAREST )
+	{
+		int row = min( (int)( r + 0.5 ), old.N - 1 );
+		int col = min( (int)( c + 0.5 ), old.M - 1 );
+
+		dst = old.getRow(row)[col];
+	}
+	else if ( sample == SAMPLE_BILINEAR )
+	{
+		const double one = (double)( (fixed)1 << COORD_BITS );
+
+		sampleEdge( old, llround( r * one ), llround( c * one ), dst, 0 );
+	}
+	else
+	{
+		int r0 = (int)r, c0 = (int)c;
+		int rows[4], cols[4];
+		double wr[4], wc[4], sum[C];
 
-				// get value of final point
-				final = UL + USlope*(c-(int)c);
+		cubicWeights( r - r0, wr );
+		cubicWeights( c - c0, wc );
+
+		for ( int k = 0; k < 4; k++ )
+		{
+			rows[k] = min( max( r0 + k - 1, 0 ), old.N - 1 );
+			cols[k] = min( max( c0 + k - 1, 0 ), old.M - 1 );
+		}
+
+		for ( int ch = 0; ch < C; ch++ )
+			sum[ch] = 0;
+
+		for ( int y = 0; y < 4; y++ )
+		{
+			const pType *src = old.getRow( rows[y] );
+
+			for ( int x = 0; x < 4; x++ )
+			{
+				wide v = traits::widen( src[cols[x]] );
+				const int *in = reinterpret_cast<const int*>( &v );
+
+				for ( int ch = 0; ch < C; ch++ )
+					sum[ch] += wr[y]*wc[x]*in[ch];
 			}
-			else if ( r > 0 && r < N && c > 0 && c < M ) { // lower right
-				// no slopes, just set value
-				final = old.pixelValue[(int)r][(int)c];
-			}				
-			else { // no value here
-				final = pixelValue[i][j]; // retain background
+		}
+
+		dst = roundPixel( sum, old.Q );
+	}
+}
+
+/******************************************************************************\
+ the cubic convolution kernel with a = -0.5 (Catmull-Rom), it passes through
+ every pixel so a whole pixel position gives back the pixel
+\******************************************************************************/
+template <class pType>
+void ImageType<pType>::cubicWeights( double t, double w[4] )
+{
+	double t2 = t*t, t3 = t2*t;
+
+	w[0] = -0.5*t3 + t2 - 0.5*t;
+	w[1] = 1.5*t3 - 2.5*t2 + 1;
+	w[2] = -1.5*t3 + 2*t2 + 0.5*t;
+	w[3] = 0.5*t3 - 0.5*t2;
+}
+
+/******************************************************************************\
+ The source position is walked along each row in fixed point, one add per
+ pixel, and every row starts again from its exact position so rounding can
+ never build up past one row.  The span of each row where all four pixels
+ around the source are inside old is found up front, inside it each pixel is
+ a single bilinear blend with no range checks.  Only the pixels outside the
+ span (edges and background) go through sampleEdge.  Bands of rows are done
+ in parallel, every row only depends on old
+\******************************************************************************/
+template <class pType>
+void ImageType<pType>::sampleMapped( const ImageType<pType>& old,
+	const double rowMap[3], const double colMap[3], fixed from )
+{
+	const fixed one = (fixed)1 << COORD_BITS;
+	const int shift = COORD_BITS - WEIGHT_BITS;
+	const int mask = ( 1 << WEIGHT_BITS ) - 1;
+
+	fixed rowStep = llround( rowMap[2] * one );
+	fixed colStep = llround( colMap[2] * one );
+
+	// the full blend needs the next row and column to exist
+	fixed rowLimit = (fixed)( old.N - 1 ) << COORD_BITS;
+	fixed colLimit = (fixed)( old.M - 1 ) << COORD_BITS;
+
+	parallelFor( N, 8, [&]( int first, int last )
+	{
+		for ( int i = first; i < last; i++ )
+		{
+			pType *dst = getRow(i);
+			fixed r = llround( ( rowMap[0] + rowMap[1]*i ) * one );
+			fixed c = llround( ( colMap[0] + colMap[1]*i ) * one );
+			int j0 = 0, j1 = M;
+
+			clipSpan( r, rowStep, from, rowLimit, j0, j1 );
+			clipSpan( c, colStep, from, colLimit, j0, j1 );
+
+			for ( int j = 0; j < j0; j++ )
+				sampleEdge( old, r + j*rowStep, c + j*colStep, dst[j],
+				    from );
+
+			fixed rj = r + j0*rowStep;
+			fixed cj = c + j0*colStep;
+
+			for ( int j = j0; j < j1; j++, rj += rowStep, cj += colStep )
+			{
+				const pType *top = old.getRow( (int)( rj >> COORD_BITS ) ) +
+				    (int)( cj >> COORD_BITS );
+				const pType *bottom = top + old.stride;
+
+				dst[j] = traits::narrow( bilerp(
+				    traits::widen( top[0] ), traits::widen( top[1] ),
+				    traits::widen( bottom[0] ), traits::widen( bottom[1] ),
+				    (int)( cj >> shift ) & mask,
+				    (int)( rj >> shift ) & mask ) );
 			}
 
-			// set final pixel value
-			pixelValue[i][j] = final;
+			for ( int j = max( j0, j1 ); j < M; j++ )
+				sampleEdge( old, r + j*rowStep, c + j*colStep, dst[j],
+				    from );
+		}
+	} );
+}
+
+/******************************************************************************\
+ the same cases the rotation has always had.  A source strictly inside old
+ blends the four pixels around it, one on the last row or column (or just
+ past it) only blends along the side that still has a neighbour
+\******************************************************************************/
+template <class pType>
+void ImageType<pType>::sampleEdge( const ImageType<pType>& old, fixed r,
+	fixed c, pType& dst, fixed from ) const
+{
+	const fixed fraction = ( (fixed)1 << COORD_BITS ) - 1;
+	const int shift = COORD_BITS - WEIGHT_BITS;
+	const int mask = ( 1 << WEIGHT_BITS ) - 1;
+
+	fixed lastRow = (fixed)( old.N - 1 ) << COORD_BITS;
+	fixed lastCol = (fixed)( old.M - 1 ) << COORD_BITS;
+	fixed rowEnd = (fixed)old.N << COORD_BITS;
+	fixed colEnd = (fixed)old.M << COORD_BITS;
+
+	if ( r < from || r >= rowEnd || c < from || c >= colEnd )
+		return;	// no value here, retain background
+
+	// pixel above and left of the source, and the ones below and right of
+	// it (the same pixel when the source is exactly on it, like ceil)
+	int r0 = (int)( r >> COORD_BITS ), c0 = (int)( c >> COORD_BITS );
+	int r1 = r0 + ( ( r & fraction ) != 0 );
+	int c1 = c0 + ( ( c & fraction ) != 0 );
+	int fr = (int)( r >> shift ) & mask;
+	int fc = (int)( c >> shift ) & mask;
+
+	wide UL = traits::widen( old.getRow(r0)[c0] );
+
+	if ( r <= lastRow && c <= lastCol )
+		dst = traits::narrow( bilerp( UL,
+		    traits::widen( old.getRow(r0)[c1] ),
+		    traits::widen( old.getRow(r1)[c0] ),
+		    traits::widen( old.getRow(r1)[c1] ), fc, fr ) );
+	else if ( r <= lastRow )	// right edge
+		dst = traits::narrow( lerp( UL,
+		    traits::widen( old.getRow(r1)[c0] ), fr ) );
+	else if ( c <= lastCol )	// bottom edge
+		dst = traits::narrow( lerp( UL,
+		    traits::widen( old.getRow(r0)[c1] ), fc ) );
+	else						// lower right
+		dst = traits::narrow( UL );
+}
+
+/******************************************************************************\
+ whole pixel maps copy pixels straight across.  For 90 and 270 degrees a row
+ of the image is a column of old, so the image is copied in square tiles that
+ keep both the rows being written and the columns being read in cache
+\******************************************************************************/
+template <class pType>
+void ImageType<pType>::copyMapped( const ImageType<pType>& old,
+	const int rowMap[3], const int colMap[3], fixed from )
+{
+	// first whole pixel at or after from
+	int lowest = (int)( ( from + ( (fixed)1 << COORD_BITS ) - 1 ) >>
+	    COORD_BITS );
+	int tiles = ( N + ROTATE_TILE - 1 ) / ROTATE_TILE;
+
+	parallelFor( tiles, 1, [&]( int first, int last )
+	{
+		for ( int t = first; t < last; t++ )
+		{
+			int iEnd = min( N, ( t+1 ) * ROTATE_TILE );
+
+			for ( int jt = 0; jt < M; jt += ROTATE_TILE )
+				for ( int i = t * ROTATE_TILE; i < iEnd; i++ )
+				{
+					int r = rowMap[0] + rowMap[1]*i;
+					int c = colMap[0] + colMap[1]*i;
+					int j0 = jt, j1 = min( M, jt + ROTATE_TILE );
+					pType *dst = getRow(i);
+
+					// a whole pixel source is inside old when it's in
+					// [lowest,N-1] x [lowest,M-1], like the blend's
+					// r >= from, ceil(r) < N
+					clipSteps( r, rowMap[2], lowest, old.N - 1, j0, j1 );
+					clipSteps( c, colMap[2], lowest, old.M - 1, j0, j1 );
+
+					r += rowMap[2]*j0;
+					c += colMap[2]*j0;
+
+					for ( int j = j0; j < j1;
+					      j++, r += rowMap[2], c += colMap[2] )
+						dst[j] = old.getRow(r)[c];
+				}
 		}
+	} );
+}
+
+/******************************************************************************\
+ the span is estimated from where the real line crosses from and limit, then
+ moved a pixel at a time until it matches the fixed point values exactly
+ (they only ever step one way, so the pixels inside always form one span)
+\******************************************************************************/
+template <class pType>
+void ImageType<pType>::clipSpan( fixed start, fixed step, fixed from,
+	fixed limit, int& lo, int& hi )
+{
+	if ( lo >= hi )
+		return;
+
+	if ( step == 0 )
+	{
+		if ( start < from || start >= limit )
+			hi = lo;
+		return;
 	}
+
+	double a = (double)( from - start ) / step;
+	double b = (double)( limit - start ) / step;
+	double low = max( min( a, b ), (double)lo );
+	double high = min( max( a, b ), (double)hi );
+
+	int jl = (int)floor( low );
+	int jh = max( jl, (int)ceil( high ) );
+
+	jl = max( jl, lo );
+	jh = min( jh, hi );
+
+	auto inside = [&]( int j )
+	{
+		fixed v = start + (fixed)j*step;
+		return v >= from && v < limit;
+	};
+
+	while ( jl < jh && !inside( jl ) )
+		jl++;
+	while ( jh > jl && !inside( jh-1 ) )
+		jh--;
+	while ( jl > lo && inside( jl-1 ) )
+		jl--;
+	while ( jh < hi && inside( jh ) )
+		jh++;
+
+	if ( jl < jh )
+	{
+		lo = jl;
+		hi = jh;
+	}
+	else
+		hi = lo;
+}
+
+template <class pType>
+void ImageType<pType>::clipSteps( int start, int step, int from, int limit,
+	int& lo, int& hi )
+{
+	if ( step == 0 )
+	{
+		if ( start < from || start > limit )
+			hi = lo;
+	}
+	else if ( step > 0 )
+	{
+		lo = max( lo, from - start );
+		hi = min( hi, limit - start + 1 );
+	}
+	else
+	{
+		lo = max( lo, start - limit );
+		hi = min( hi, start - from + 1 );
+	}
+
+	if ( hi < lo )
+		hi = lo;
+}
+
+/******************************************************************************\
+ fixed point blends, done one channel (int) at a time in 64 bits so even int
+ pixels can't overflow.  Results are rounded to the nearest value
+\******************************************************************************/
+template <class pType>
+typename ImageType<pType>::wide ImageType<pType>::lerp( const wide& a,
+	const wide& b, int f )
+{
+	const int C = sizeof(wide) / sizeof(int);
+	const fixed whole = (fixed)1 << WEIGHT_BITS;
+	const int *ca = reinterpret_cast<const int*>( &a );
+	const int *cb = reinterpret_cast<const int*>( &b );
+	wide result;
+	int *out = reinterpret_cast<int*>( &result );
+
+	for ( int k = 0; k < C; k++ )
+		out[k] = (int)( ( ca[k]*( whole - f ) + (fixed)cb[k]*f +
+		    ( whole >> 1 ) ) >> WEIGHT_BITS );
+
+	return result;
+}
+
+template <class pType>
+typename ImageType<pType>::wide ImageType<pType>::bilerp( const wide& UL,
+	const wide& UR, const wide& LL, const wide& LR, int fc, int fr )
+{
+	const int C = sizeof(wide) / sizeof(int);
+	const fixed whole = (fixed)1 << WEIGHT_BITS;
+	const int *ul = reinterpret_cast<const int*>( &UL );
+	const int *ur = reinterpret_cast<const int*>( &UR );
+	const int *ll = reinterpret_cast<const int*>( &LL );
+	const int *lr = reinterpret_cast<const int*>( &LR );
+	wide result;
+	int *out = reinterpret_cast<int*>( &result );
+
+	for ( int k = 0; k < C; k++ )
+	{
+		fixed top = ul[k]*( whole - fc ) + (fixed)ur[k]*fc;
+		fixed bottom = ll[k]*( whole - fc ) + (fixed)lr[k]*fc;
+
+		out[k] = (int)( ( top*( whole - fr ) + bottom*fr +
+		    ( (fixed)1 << ( 2*WEIGHT_BITS - 1 ) ) ) >> ( 2*WEIGHT_BITS ) );
+	}
+
+	return result;
 }
 
 /******************************************************************************\
@@ -741,10 +2128,15 @@ ImageType<pType>& ImageType<pType>::operator+ ( const ImageType<pType>& rhs )
 	float a = 0.5;
 
 	//the general formula is aI1(r,c)+(1-a)I2(r,c)
-	for(int i = 0; i < N; i++)
+	for(int i = 0; i < N; i++) {
+		pType *dst = getRow(i);
+		const pType *src = rhs.getRow(i);
 		for(int j = 0; j < M; j++)
 			// set new pixel value
-			pixelValue[i][j] = pixelValue[i][j]*a+rhs.pixelValue[i][j]*(1.0-a);
+			dst[j] = traits::narrow(
+			    traits::widen(dst[j])*a +
+			    traits::widen(src[j])*(1.0-a) );
+	}
 
 	return *this;	// return current object
 }
@@ -757,52 +2149,7 @@ ImageType<pType>& ImageType<pType>::operator+ ( const ImageType<pType>& rhs )
 template <class pType>
 void ImageType<pType>::erode(){
 
-    ImageType<pType> temp = *this;
-
-	for(int i = 0; i < N; i++)
-		for(int j = 0; j < M; j++){
-
-			// I check to see if the surrounding cells are 0, if
-			// they are, then set i,j to zero. 
-			// I must also check to see if the surrounding cells are
-			// in bounds which is what the first if does. If the
-			// value is not in bounds, then dont try to change it.
-			// Bad things will happen if you try to change it and it
-			// doesnt exist. 
-			if( (i - 1 != -1) && (j - 1 != -1))
-				if(pixelValue[i - 1][j - 1] == 0)
-					temp.pixelValue[i][j] = 0;
-
-			if(j - 1 != -1)
-				if(pixelValue[i][j - 1] == 0)
-					temp.pixelValue[i][j] = 0;
-
-			if( (i + 1 != N) && (j - 1 != -1))
-				if(pixelValue[i + 1][j - 1] == 0)
-					temp.pixelValue[i][j] = 0;
-
-			if(i - 1 != -1)
-				if(pixelValue[i - 1][j] == 0)
-					temp.pixelValue[i][j] = 0;
-
-			if(i + 1 != N)
-				if(pixelValue[i + 1][j] == 0)
-					temp.pixelValue[i][j] = 0;
-
-			if( (i - 1 != -1) && (j + 1 != M))
-				if(pixelValue[i - 1][j + 1] == 0)
-					temp.pixelValue[i][j] = 0;
-
-			if(j + 1 != M)
-				if(pixelValue[i][j + 1] == 0)
-					temp.pixelValue[i][j] = 0;
-
-			if( (i + 1 != N) && (j + 1 != M))
-				if(pixelValue[i + 1][j + 1] == 0)
-					temp.pixelValue[i][j] = 0;
-		}
-
-    *this = temp;
+	morph( StructuringElement(), 0 );
 }
 
 /******************************************************************************\
@@ -811,50 +2158,58 @@ void ImageType<pType>::erode(){
 template <class pType>
 void ImageType<pType>::dilate()
 {
-	ImageType<pType> temp = *this;
-
-	bool endloop;
-
-	for(int i = 0; i < N; i++)
-		for(int j = 0; j < M; j++){
-
-			// modified version of errode, except i check for black
-			// and then change the surroundings to that value as well
-			if( (i - 1 != -1) && (j - 1 != -1))
-				if(pixelValue[i - 1][j - 1] == Q)
-					temp.pixelValue[i][j] = Q;
+	morph( StructuringElement(), Q );
+}
 
-			if(j - 1 != -1)
-				if(pixelValue[i][j - 1] == Q)
-					temp.pixelValue[i][j] = Q;
+template <class pType>
+void ImageType<pType>::erode( const StructuringElement& element )
+{
+	morph( element, 0 );
+}
 
-			if( (i + 1 != N) && (j - 1 != -1))
-				if(pixelValue[i + 1][j - 1] == Q)
-					temp.pixelValue[i][j] = Q;
+template <class pType>
+void ImageType<pType>::dilate( const StructuringElement& element )
+{
+	morph( element, Q );
+}
 
-			if(i - 1 != -1)
-				if(pixelValue[i - 1][j] == Q)
-					temp.pixelValue[i][j] = Q;
+/******************************************************************************\
+ the pixels that are value are marked in a mask of bytes, the element spreads
+ the marks (see morphology.h) and every marked pixel is set to value.  The
+ mask holds everything the second pass needs so the image is changed in
+ place
+\******************************************************************************/
+template <class pType>
+void ImageType<pType>::morph( const StructuringElement& element, int value )
+{
+	vector<unsigned char> mask( (long)N * M );
 
-			if(i + 1 != N)
-				if(pixelValue[i + 1][j] == Q)
-					temp.pixelValue[i][j] = Q;
+	parallelFor( N, 16, [&]( int first, int last )
+	{
+		for ( int i = first; i < last; i++ )
+		{
+			const pType *row = getRow(i);
+			unsigned char *hit = mask.data() + (long)i*M;
 
-			if( (i - 1 != -1) && (j + 1 != M))
-				if(pixelValue[i - 1][j + 1] == Q)
-					temp.pixelValue[i][j] = Q;
+			for ( int j = 0; j < M; j++ )
+				hit[j] = ( row[j] == value );
+		}
+	} );
 
-			if(j + 1 != M)
-				if(pixelValue[i][j + 1] == Q)
-					temp.pixelValue[i][j] = Q;
+	element.spread( mask, N, M );
 
-			if( (i + 1 != N) && (j + 1 != M))
-				if(pixelValue[i + 1][j + 1] == Q)
-					temp.pixelValue[i][j] = Q;
+	parallelFor( N, 16, [&]( int first, int last )
+	{
+		for ( int i = first; i < last; i++ )
+		{
+			pType *row = getRow(i);
+			const unsigned char *hit = mask.data() + (long)i*M;
 
+			for ( int j = 0; j < M; j++ )
+				if ( hit[j] )
+					row[j] = value;
 		}
-
-	*this = temp;
+	} );
 }
 
 /******************************************************************************\
@@ -866,57 +2221,168 @@ void ImageType<pType>::dilate()
 template <class pType>
 void ImageType<pType>::threshold(){
 
-	pType T, avg;
-	int divisor = 0;
+	threshold( THRESHOLD_MEAN );
+}
+
+/******************************************************************************\
+ the level is picked from one histogram pass and the thresholding is a second
+ pass, color images and images with too many levels for a histogram work the
+ mean out from the pixels.  The histogram counts samples outside [0,Q] as 0
+ or Q, so the mean is also worked out from the pixels when a sample could be
+ outside (enlargeImage and operator- leave them in int images), which costs
+ one more pass to find the range
+\******************************************************************************/
+template <class pType>
+void ImageType<pType>::threshold( ThresholdType type, double fraction )
+{
+	typedef typename traits::channel channel;
+	const int C = traits::color ? 3 : 1;
+	wide L;
+	int *level = reinterpret_cast<int*>( &L );
+	bool outside = false;
+
+	if ( type == THRESHOLD_MEAN && !traits::color &&
+	    ( numeric_limits<channel>::is_signed ||
+	      Q < (int)numeric_limits<channel>::max() ) )
+	{
+		SampleStats stats[1];
+
+		statistics( stats );
+		outside = ( stats[0].min < 0 || stats[0].max > Q );
+	}
+
+	if ( type == THRESHOLD_MEAN &&
+	    ( traits::color || Q > MAX_HISTOGRAM_LEVELS || outside ) )
+	{
+		threshold( traits::narrow( meanLevel() ) );
+		return;
+	}
+
+	Histogram hist( *this );
+
+	for ( int c = 0; c < C; c++ )
+		switch ( type )
+		{
+			case THRESHOLD_MEAN:
+				level[c] = meanLevel( hist, Q );
+				break;
+			case THRESHOLD_OTSU:
+				level[c] = hist.otsu( c );
+				break;
+			case THRESHOLD_TRIANGLE:
+				level[c] = hist.triangle( c );
+				break;
+			case THRESHOLD_PERCENTILE:
+				level[c] = hist.percentile( fraction, c );
+				break;
+			default:
+				throw (string)"Unknown way to threshold!";
+		}
+
+	threshold( traits::narrow( L ) );
+}
+
+template <class pType>
+typename ImageType<pType>::wide ImageType<pType>::meanLevel() const
+{
+	typedef typename traits::channel channel;
+	const int C = traits::color ? 3 : 1;
+	SampleStats above[3];
+	pType avg;
+	wide T;
+	int *level = reinterpret_cast<int*>( &T );
 
 	//Lets try to find a good number to use for an automatic threshold
 	avg = meanColor();
-	T = 0;
 
 	// take the average of the values greate than the images average
-	for ( int i = 0; i < N; i++ )
+	reduceRows( above, [&]( const pType *row, SampleStats *rowStats )
+	{
 		for ( int j = 0; j < M; j++ )
-		{
-			if ( pixelValue[i][j] > avg )
+			if ( row[j] > avg )
 			{
-				T = T + pixelValue[i][j];
-				divisor++;
+				const channel *val =
+				    reinterpret_cast<const channel*>( &row[j] );
+				for ( int c = 0; c < C; c++ )
+					rowStats[c].add( val[c] );
 			}
-		}
-	
+	} );
+
 	// this is the average value of the pixels greater than old average
-	if ( divisor != 0 )
-		T = T / divisor;
+	for ( int c = 0; c < C; c++ )
+		level[c] = above[c].intMean();
 
 	// take the value 2/5 of the way to Q from the current location
 	T = T + (Q - toInt(T)) / 2.5;
 
-	// run the actual threshold with the correct data
-	threshold( T );
+	return T;
+}
+
+// the same steps on the counts of a grayscale image
+template <class pType>
+int ImageType<pType>::meanLevel( const Histogram& hist, int Q )
+{
+	long long n = hist.total(), sum = 0, above = 0, divisor = 0;
+	int avg, T = 0;
+
+	for ( int v = 0; v <= Q; v++ )
+		sum += (long long)v * hist.count( v );
+	avg = ( n == 0 ? 0 : sum / n );
+
+	for ( int v = avg + 1; v <= Q; v++ )
+	{
+		above += (long long)v * hist.count( v );
+		divisor += hist.count( v );
+	}
+
+	if ( divisor != 0 )
+		T = above / divisor;
+
+	T = T + (Q - T) / 2.5;
+
+	return T;
 }
 
 /******************************************************************************\
- Thresholds an image. If > T, i,j = 255 | if <= T, i,j = 0
+ Thresholds an image. If > T, i,j = 255 | if <= T, i,j = 0.  Grayscale images
+ go through a PointMap, a color pixel is compared as a whole so it can't be
+ done a channel at a time
 \******************************************************************************/
 template <class pType>
 void ImageType<pType>::threshold( pType L ){
 
-	for(int i = 0; i < N; i++)
+	if ( !traits::color )
+	{
+		applyMap( PointMap::threshold( Q, 1, toInt( L ) ) );
+		return;
+	}
+
+	for(int i = 0; i < N; i++) {
+		pType *row = getRow(i);
 		for(int j = 0; j < M; j++){
 
-			if(pixelValue[i][j] < L)
-				pixelValue[i][j] = 0;
-			else pixelValue[i][j] = Q;
+			if(row[j] < L)
+				row[j] = 0;
+			else row[j] = Q;
 
 		}
+	}
 }
 
+/******************************************************************************\
+ Set every pixel to 0, each row is one contiguous fill
+\******************************************************************************/
 template <class pType>
 void ImageType<pType>::blackOut()
 {
+	pType black;
+	black = 0;
+
 	for ( int i = 0; i < N; i++ )
-		for ( int j = 0; j < M; j++ )
-			pixelValue[i][j] = 0;
+	{
+		pType *row = getRow(i);
+		fill( row, row + M, black );
+	}
 }
 
 #endif /* IMAGE */
@@ -0,0 +1,172 @@
+/******************************************************************************\
+ Checks ImageType operations that have gone wrong before against what they
+ are known to give.  Run with "make check", it exits with 1 if anything
+ differs.
+\******************************************************************************/
+#include <cstdio>
+#include <cstdlib>
+#include "image.h"
+
+using namespace std;
+
+// number of pixels of the image that aren't 0
+long countSet( const ImageType<int>& img )
+{
+	int N, M, Q;
+	long set = 0;
+
+	img.getImageInfo( N, M, Q );
+
+	for ( int i = 0; i < N; i++ )
+		for ( int j = 0; j < M; j++ )
+			if ( img.getPixelVal( i, j ) != 0 )
+				set++;
+
+	return set;
+}
+
+// an int image can hold values above Q, the automatic threshold has to use
+// them as they are instead of counting them as Q
+bool checkThresholdOutside()
+{
+	const int vals[16] = { 0, 10, 20, 30, 40, 50, 60, 70, 80, 90, 100, 300,
+	    400, 500, 600, 700 };
+	ImageType<int> img( 4, 4, 255 );
+
+	for ( int k = 0; k < 16; k++ )
+		img.setPixelVal( k / 4, k % 4, vals[k] );
+
+	img.threshold( THRESHOLD_MEAN );
+
+	if ( countSet( img ) != 3 )
+	{
+		printf( "threshold with values above Q: %ld pixels set, not 3\n",
+		    countSet( img ) );
+		return false;
+	}
+
+	return true;
+}
+
+// number of pixels of the image that aren't val
+long countOther( const ImageType<int>& img, int val )
+{
+	int N, M, Q;
+	long other = 0;
+
+	img.getImageInfo( N, M, Q );
+
+	for ( int i = 0; i < N; i++ )
+		for ( int j = 0; j < M; j++ )
+			if ( img.getPixelVal( i, j ) != val )
+				other++;
+
+	return other;
+}
+
+// sets every pixel through the rows handed out
+void fill( ImageType<int>& img, int val )
+{
+	int N, M, Q;
+
+	img.getImageInfo( N, M, Q );
+
+	for ( int i = 0; i < N; i++ )
+	{
+		int *row = img.getRow(i);
+		for ( int j = 0; j < M; j++ )
+			row[j] = val;
+	}
+}
+
+// writes through views (and a view of a view) have to throw away the
+// pyramid shrinkImage keeps for the image they're views of, and writes to
+// the image have to reach the pyramids of its views
+bool checkViewPyramid()
+{
+	ImageType<int> img( 8, 8, 255 ), view, inner, small;
+	bool ok = true;
+
+	fill( img, 10 );
+	view.getSubView( 0, 0, 8, 8, img );
+	inner.getSubView( 0, 0, 8, 8, view );
+
+	small.shrinkImage( 2.0, img );
+	fill( view, 200 );
+	small.shrinkImage( 2.0, img );
+
+	if ( countOther( small, 200 ) != 0 )
+	{
+		printf( "shrinkImage missed a write through a view\n" );
+		ok = false;
+	}
+
+	fill( inner, 50 );
+	small.shrinkImage( 2.0, img );
+
+	if ( countOther( small, 50 ) != 0 )
+	{
+		printf( "shrinkImage missed a write through a view of a view\n" );
+		ok = false;
+	}
+
+	small.shrinkImage( 2.0, view );
+	fill( img, 70 );
+	small.shrinkImage( 2.0, view );
+
+	if ( countOther( small, 70 ) != 0 )
+	{
+		printf( "shrinkImage of a view missed a write to its image\n" );
+		ok = false;
+	}
+
+	return ok;
+}
+
+// shrinking into a view writes the region of the image it's a view of,
+// whether or not the shrink comes from a pyramid level
+bool checkShrinkIntoView()
+{
+	ImageType<int> img( 12, 12, 255 ), big( 12, 12, 255 ), view;
+	bool ok = true;
+
+	fill( img, 10 );
+
+	// 6 x 6 is pyramid level 1, 4 x 4 comes from the summed area table
+	for ( int s = 2; s <= 3; s++ )
+	{
+		fill( big, 0 );
+		view.getSubView( 0, 0, 12 / s, 12 / s, big );
+		view.shrinkImage( (double)s, img );
+
+		if ( countOther( big, 0 ) != ( 12 / s ) * ( 12 / s ) ||
+		     countOther( view, 10 ) != 0 )
+		{
+			printf( "shrinkImage by %d didn't write into the view\n", s );
+			ok = false;
+		}
+	}
+
+	return ok;
+}
+
+int main()
+{
+	bool ok = true;
+
+	try
+	{
+		ok &= checkThresholdOutside();
+		ok &= checkViewPyramid();
+		ok &= checkShrinkIntoView();
+	}
+	catch ( string err )
+	{
+		printf( "%s\n", err.c_str() );
+		ok = false;
+	}
+
+	printf( ok ? "image checks passed\n" : "image checks FAILED\n" );
+
+	return ok ? 0 : 1;
+}
@@ -1,14 +1,37 @@
 #include "imageIO.h"
+#include "pixelKernels.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 using namespace std;
 
-void readImageHeader(const char fname[], int& N, int& M, int& Q, bool& type)
+// a file mapped into memory, kept alive for as long as an image views it
+struct MappedFile
+{
+	void *addr;		// start of the mapping
+	size_t len;		// length of the mapping in bytes
+};
+
+// largest Q a PGM or PPM file can have
+const int MAX_LEVELS = 65535;
+
+// files with more than 256 levels store each sample in two bytes
+static int sampleBytes( int Q )
+{
+	return ( Q > 255 ? 2 : 1 );
+}
+
+/******************************************************************************\
+ opens fname and reads a PGM or PPM header, color is set for a PPM.  ifp is
+ left at the first byte of the pixel data
+\******************************************************************************/
+static void openAnyImage( const char fname[], ifstream& ifp, bool& color,
+	int& N, int& M, int& Q )
 {
-	int i, j;
-	unsigned char *charImage;
 	char header [100], *ptr;
 	string msg;
-	ifstream ifp;
 
 	ifp.open( fname, ios::in | ios::binary );
 
@@ -21,19 +44,17 @@ void readImageHeader(const char fname[], int& N, int& M, int& Q, bool& type)
 
 	// read header
 
-	type = false; // PGM
-
 	ifp.getline( header, 100, '\n' );
 	if ( (header[0] == 80) &&  /* 'P' */
 	     (header[1] == 53) )   /* '5' */
 	{
-		type = false;
+		color = false;
 	}
 	else if ( (header[0] == 80) &&  /* 'P' */
 	          (header[1] == 54) )   /* '6' */
 	{
-		type = true;
-	} 
+		color = true;
+	}
 	else
 	{
 		msg = "Image ";
@@ -42,268 +63,846 @@ void readImageHeader(const char fname[], int& N, int& M, int& Q, bool& type)
 		throw msg;
 	}
 
-	ifp.getline( header, 100, '\n');
+	ifp.getline( header, 100, '\n' );
+
 	while( header[0] == '#' )
-		ifp.getline( header, 100, '\n' );
+		ifp.getline( header, 100, '\n');
 
 	M = strtol( header, &ptr, 0 );
 	N = atoi( ptr );
 
 	ifp.getline( header, 100, '\n' );
-
 	Q = strtol( header, &ptr, 0 );
+}
+
+void readImageHeader(const char fname[], int& N, int& M, int& Q, bool& type)
+{
+	ifstream ifp;
+
+	openAnyImage( fname, ifp, type, N, M, Q );
 
 	ifp.close();
 }
 
-void readImage(const char fname[], ImageType<int>& image)
+/******************************************************************************\
+ opens fname and reads a PGM (color = false) or PPM (color = true) header,
+ leaving ifp at the first byte of the pixel data
+\******************************************************************************/
+static void openImage( const char fname[], ifstream& ifp, bool color, int& N,
+	int& M, int& Q )
 {
-	int i, j;
-	int N, M, Q;
-	unsigned char *charImage;
-	char header [100], *ptr;
+	bool isColor;
 	string msg;
-	ifstream ifp;
 
-	ifp.open( fname, ios::in | ios::binary );
+	openAnyImage( fname, ifp, isColor, N, M, Q );
 
-	if ( !ifp )
+	if ( isColor != color )
 	{
-		msg = "Can't read image: ";
+		msg = "Image ";
 		msg += fname;
+		msg += ( color ? " is not PPM" : " is not PGM" );
 		throw msg;
 	}
+}
 
-	// read header
+/******************************************************************************\
+ reads the raw bytes of the image data, pixelBytes is the number of bytes in
+ one pixel (channels times the bytes per sample).  The returned buffer must be
+ deleted by the caller
+\******************************************************************************/
+static unsigned char* readRaster( const char fname[], ifstream& ifp, int N,
+	int M, int pixelBytes )
+{
+	string msg;
+	unsigned char *charImage;
+	long size = (long)pixelBytes*M*N;
 
-	ifp.getline( header, 100, '\n' );
-	if ( ( header[0] != 80 ) ||    /* 'P' */
-             ( header[1] != 53 ) ) {   /* '5' */
+	charImage = new unsigned char [size];
+
+	ifp.read( reinterpret_cast<char *>(charImage), size );
+
+	if ( ifp.fail() )
+	{
+		delete [] charImage;
 		msg = "Image ";
 		msg += fname;
-		msg += " is not PGM";
+		msg += " has wrong size";
 		throw msg;
 	}
 
-	ifp.getline( header, 100, '\n' );
+	ifp.close();
 
-	while( header[0] == '#' )
-		ifp.getline( header, 100, '\n');
+	return charImage;
+}
 
-	M = strtol( header, &ptr, 0 );
-	N = atoi( ptr );
+/******************************************************************************\
+ creates fname and writes a PGM (channels = 1) or PPM (channels = 3) header,
+ leaving ofp ready for the pixel data
+\******************************************************************************/
+static void createImage( const char fname[], ofstream& ofp, int N, int M,
+	int Q, int channels )
+{
+	string msg;
 
-	ifp.getline( header, 100, '\n' );
-	Q = strtol( header, &ptr, 0 );
+	if ( Q < 0 || Q > MAX_LEVELS )
+	{
+		msg = "Can't store more than 65536 levels in ";
+		msg += fname;
+		throw msg;
+	}
 
-	charImage = (unsigned char *) new unsigned char [M*N];
+	ofp.open( fname, ios::out | ios::binary );
 
-	ifp.read( reinterpret_cast<char *>(charImage), (M*N)*sizeof(unsigned char));
+	if ( !ofp )
+	{
+		msg = "Can't open file: ";
+		msg += fname;
+		throw msg;
+	}
 
-	if ( ifp.fail() )
+	ofp << ( channels == 3 ? "P6" : "P5" ) << endl;
+	ofp << M << " " << N << endl;
+	ofp << Q << endl;
+}
+
+/******************************************************************************\
+ writes the header and the raw bytes of an image, channels is 1 for PGM and 3
+ for PPM.  Each sample takes sampleBytes(Q) bytes
+\******************************************************************************/
+static void writeRaster( const char fname[], const unsigned char charImage[],
+	int N, int M, int Q, int channels )
+{
+	string msg;
+	ofstream ofp;
+
+	createImage( fname, ofp, N, M, Q, channels );
+
+	ofp.write( reinterpret_cast<const char *>(charImage),
+	    (long)channels*sampleBytes(Q)*M*N );
+
+	if ( ofp.fail() )
+	{
+		msg = "Can't write image ";
+		msg += fname;
+		throw msg;
+	}
+
+	ofp.close();
+}
+
+/******************************************************************************\
+ converts n samples between the bytes of a file and pixel channels, each
+ sample is one byte or (for Q above 255) two big-endian bytes
+\******************************************************************************/
+template <class sType>
+static void unpackSamples( const unsigned char src[], sType dst[], long n,
+	int Q )
+{
+	if ( sampleBytes( Q ) == 2 )
+		widenSamples16( src, dst, n );
+	else
+		widenSamples( src, dst, n );
+}
+
+template <class sType>
+static void packSamples( const sType src[], unsigned char dst[], long n,
+	int Q )
+{
+	if ( sampleBytes( Q ) == 2 )
+		narrowSamples16( src, dst, n, Q );
+	else
+		narrowSamples( src, dst, n, Q );
+}
+
+/******************************************************************************\
+ converts one row of a PGM (M samples) or a PPM (3*M samples) into pixels.
+ rgb and rgb8 hold their channels in the same order as the file, so a color
+ row is simply 3*M samples for the kernels in pixelKernels.h
+\******************************************************************************/
+static_assert( sizeof(rgb) == 3*sizeof(int), "rgb must be three packed ints" );
+static_assert( sizeof(rgb8) == 3, "rgb8 must be three packed bytes" );
+
+static void unpackRow( const unsigned char src[], int row[], int M, int Q )
+{
+	unpackSamples( src, row, M, Q );
+}
+
+static void unpackRow( const unsigned char src[], unsigned char row[], int M,
+	int Q )
+{
+	unpackSamples( src, row, M, Q );
+}
+
+static void unpackRow( const unsigned char src[], unsigned short row[], int M,
+	int Q )
+{
+	unpackSamples( src, row, M, Q );
+}
+
+static void unpackRow( const unsigned char src[], rgb row[], int M, int Q )
+{
+	unpackSamples( src, reinterpret_cast<int*>(row), 3L*M, Q );
+}
+
+static void unpackRow( const unsigned char src[], rgb8 row[], int M, int Q )
+{
+	unpackSamples( src, reinterpret_cast<unsigned char*>(row), 3L*M, Q );
+}
+
+/******************************************************************************\
+ converts one row of pixels into the bytes of a PGM or PPM row, values are
+ clipped to the range [0,Q]
+\******************************************************************************/
+static void packRow( const int row[], unsigned char dst[], int M, int Q )
+{
+	packSamples( row, dst, M, Q );
+}
+
+static void packRow( const unsigned char row[], unsigned char dst[], int M,
+	int Q )
+{
+	packSamples( row, dst, M, Q );
+}
+
+static void packRow( const unsigned short row[], unsigned char dst[], int M,
+	int Q )
+{
+	packSamples( row, dst, M, Q );
+}
+
+static void packRow( const rgb row[], unsigned char dst[], int M, int Q )
+{
+	packSamples( reinterpret_cast<const int*>(row), dst, 3L*M, Q );
+}
+
+static void packRow( const rgb8 row[], unsigned char dst[], int M, int Q )
+{
+	packSamples( reinterpret_cast<const unsigned char*>(row), dst, 3L*M,
+	    Q );
+}
+
+/******************************************************************************\
+ makes sure a file with Q levels fits in the pixel type without losing
+ anything, 8 bit images can't hold the samples of a 16 bit file
+\******************************************************************************/
+template <class pType>
+static void checkLevels( const char fname[], int Q )
+{
+	string msg;
+
+	if ( Q > pixelTraits<pType>::maxLevel )
 	{
 		msg = "Image ";
 		msg += fname;
-		msg += " has wrong size";
+		msg += " has too many levels for 8 bit pixels";
 		throw msg;
 	}
+}
 
-	ifp.close();
+/******************************************************************************\
+ reads a PGM file into a grayscale image or a PPM file into a color image of
+ any pixel type, the image is resized to match the file
+\******************************************************************************/
+template <class pType>
+static void readPixels( const char fname[], ImageType<pType>& image )
+{
+	int N, M, Q;
+	int channels = ( pixelTraits<pType>::color ? 3 : 1 );
+	long rowBytes;
+	unsigned char *charImage;
+	ifstream ifp;
+
+	openImage( fname, ifp, pixelTraits<pType>::color, N, M, Q );
+	checkLevels<pType>( fname, Q );
+	rowBytes = (long)channels*sampleBytes(Q)*M;
+	charImage = readRaster( fname, ifp, N, M, channels*sampleBytes(Q) );
+
+	// every pixel is set below so the image doesn't need to be filled
+	image.setImageInfo( N, M, Q, FILL_NONE );
 
 	//
-	// Convert the unsigned characters to integers
+	// Convert the unsigned characters to pixels
 	//
 
-	int val;
+	for ( int i = 0; i < N; i++ )
+		unpackRow( charImage + i*rowBytes, image.getRow(i), M, Q );
 
-	for(i=0; i<N; i++)
-		for(j=0; j<M; j++)
-		{
-			val = (int)charImage[i*M+j];
-			image.setPixelVal(i, j, val);     
-   		}
+	delete [] charImage;
+}
+
+/******************************************************************************\
+ reads a PPM file into the planes of a PlanarImage, a row at a time through
+ one row of interleaved pixels
+\******************************************************************************/
+template <class pType>
+static void readPlanes( const char fname[], PlanarImage<pType>& image )
+{
+	typedef typename PlanarImage<pType>::channel channel;
+
+	int N, M, Q;
+	long rowBytes;
+	unsigned char *charImage;
+	ifstream ifp;
+
+	openImage( fname, ifp, true, N, M, Q );
+	checkLevels<pType>( fname, Q );
+	rowBytes = 3L*sampleBytes(Q)*M;
+	charImage = readRaster( fname, ifp, N, M, 3*sampleBytes(Q) );
+
+	image.setImageInfo( N, M, Q, FILL_NONE );
+
+	vector<pType> row( M );
+
+	for ( int i = 0; i < N; i++ )
+	{
+		unpackRow( charImage + i*rowBytes, &row[0], M, Q );
+		splitChannels( reinterpret_cast<const channel*>( &row[0] ),
+		    image.getPlane(0).getRow(i), image.getPlane(1).getRow(i),
+		    image.getPlane(2).getRow(i), M );
+	}
 
 	delete [] charImage;
 }
 
-void readImage(const char fname[], ImageType<rgb>& image)
+/******************************************************************************\
+ writes a grayscale image as a PGM or a color image as a PPM, values are
+ clipped to the range [0,Q]
+\******************************************************************************/
+template <class pType>
+static void writePixels( const char fname[], const ImageType<pType>& image )
+{
+	int N, M, Q;
+	int channels = ( pixelTraits<pType>::color ? 3 : 1 );
+	long rowBytes;
+	unsigned char *charImage;
+
+	image.getImageInfo( N, M, Q );
+
+	rowBytes = (long)channels*sampleBytes(Q)*M;
+	charImage = new unsigned char [rowBytes*N];
+
+	// convert the pixel values to bytes, clipping them here
+	for ( int i = 0; i < N; i++ )
+		packRow( image.getRow(i), charImage + i*rowBytes, M, Q );
+
+	try
+	{
+		writeRaster( fname, charImage, N, M, Q, channels );
+	}
+	catch ( string )
+	{
+		delete [] charImage;
+		throw;
+	}
+
+	delete [] charImage;
+}
+
+/******************************************************************************\
+ writes the planes of a PlanarImage as a PPM, values are clipped to [0,Q]
+\******************************************************************************/
+template <class pType>
+static void writePlanes( const char fname[], const PlanarImage<pType>& image )
 {
-	int i, j;
+	typedef typename PlanarImage<pType>::channel channel;
+
 	int N, M, Q;
+	long rowBytes;
 	unsigned char *charImage;
+
+	image.getImageInfo( N, M, Q );
+
+	rowBytes = 3L*sampleBytes(Q)*M;
+	charImage = new unsigned char [rowBytes*N];
+
+	vector<pType> row( M );
+
+	for ( int i = 0; i < N; i++ )
+	{
+		mergeChannels( image.getPlane(0).getRow(i),
+		    image.getPlane(1).getRow(i), image.getPlane(2).getRow(i),
+		    reinterpret_cast<channel*>( &row[0] ), M );
+		packRow( &row[0], charImage + i*rowBytes, M, Q );
+	}
+
+	try
+	{
+		writeRaster( fname, charImage, N, M, Q, 3 );
+	}
+	catch ( string )
+	{
+		delete [] charImage;
+		throw;
+	}
+
+	delete [] charImage;
+}
+
+/******************************************************************************\
+ reads one '\n' terminated line out of a memory buffer into line (at most
+ size-1 characters are kept), pos is moved to the start of the next line
+\******************************************************************************/
+static void getLine( const char *&pos, const char *end, char line[], int size )
+{
+	int len = 0;
+
+	while ( pos < end && *pos != '\n' )
+	{
+		if ( len < size-1 )
+			line[len++] = *pos;
+		pos++;
+	}
+	line[len] = '\0';
+
+	// skip the newline
+	if ( pos < end )
+		pos++;
+}
+
+/******************************************************************************\
+ releases a mapped file, this is handed to ImageType::setBuffer so the pages
+ are unmapped when the image lets go of them
+\******************************************************************************/
+static void unmapFile( void *handle )
+{
+	MappedFile *file = static_cast<MappedFile*>(handle);
+
+	munmap( file->addr, file->len );
+	delete file;
+}
+
+/******************************************************************************\
+ maps fname into memory and parses the PGM (color = false) or PPM (color =
+ true) header straight out of the mapping, so the file is only opened once.
+ data is set to the first byte of the pixels, which is checked to be entirely
+ inside the file.  The mapping is private so writing to the pages never
+ changes the file.  The returned file must be released with unmapFile
+\******************************************************************************/
+static MappedFile* mapFile( const char fname[], bool color, int& N, int& M,
+	int& Q, unsigned char *&data )
+{
 	char header [100], *ptr;
 	string msg;
-	ifstream ifp;
+	struct stat info;
+	int fd;
+	void *addr;
+
+	fd = open( fname, O_RDONLY );
 
-	ifp.open(fname, ios::in | ios::binary);
-  
-	if (!ifp)
+	if ( fd < 0 || fstat( fd, &info ) != 0 || info.st_size == 0 )
 	{
+		if ( fd >= 0 )
+			close( fd );
 		msg = "Can't read image: ";
 		msg += fname;
 		throw msg;
 	}
 
-	// read header
+	addr = mmap( NULL, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+	    fd, 0 );
 
-	ifp.getline(header,100,'\n');
+	// the mapping stays valid after the file is closed
+	close( fd );
 
-	if ( (header[0]!=80) ||    /* 'P' */
-	     (header[1]!=54) ) {   /* '6' */
-		msg = "Image ";
+	if ( addr == MAP_FAILED )
+	{
+		msg = "Can't map image: ";
 		msg += fname;
-		msg += " is not PPM";
 		throw msg;
 	}
 
-	ifp.getline(header,100,'\n');
-	while(header[0]=='#')
-		ifp.getline(header,100,'\n');
+	MappedFile *file = new MappedFile;
+	file->addr = addr;
+	file->len = info.st_size;
+
+	const char *pos = static_cast<const char*>(addr);
+	const char *end = pos + info.st_size;
 
-	M=strtol(header,&ptr,0);
-	N=atoi(ptr);
- 
-	ifp.getline(header,100,'\n');
-	Q=strtol(header,&ptr,0);
+	// read header, the same way openImage does
+
+	getLine( pos, end, header, 100 );
+	if ( ( header[0] != 80 ) ||                  /* 'P' */
+	     ( header[1] != ( color ? 54 : 53 ) ) )  /* '6' or '5' */
+	{
+		unmapFile( file );
+		msg = "Image ";
+		msg += fname;
+		msg += ( color ? " is not PPM" : " is not PGM" );
+		throw msg;
+	}
 
-	charImage = (unsigned char *) new unsigned char [3*M*N];
+	getLine( pos, end, header, 100 );
+	while( header[0] == '#' )
+		getLine( pos, end, header, 100 );
 
-	ifp.read( reinterpret_cast<char *>(charImage), (3*M*N)*sizeof(unsigned char));
+	M = strtol( header, &ptr, 0 );
+	N = atoi( ptr );
 
-	if (ifp.fail())
+	getLine( pos, end, header, 100 );
+	Q = strtol( header, &ptr, 0 );
+
+	if ( N < 0 || M < 0 ||
+	     end - pos < (long)N * M * ( color ? 3 : 1 ) * sampleBytes( Q ) )
 	{
+		unmapFile( file );
 		msg = "Image ";
 		msg += fname;
 		msg += " has wrong size";
 		throw msg;
 	}
 
-	ifp.close();
- 
-	/* Convert the unsigned characters to integers */
-
-	rgb val;
- 
-	for(i=0; i < N; i++)
-		for(j=0; j < 3*M; j+=3)
-		{
-			val.r = (int)charImage[i*3*M+j];
-			val.g = (int)charImage[i*3*M+j+1];
-			val.b = (int)charImage[i*3*M+j+2];
-			image.setPixelVal(i, j/3, val);
-		}
+	data = (unsigned char*)pos;
 
-	delete [] charImage;
+	return file;
+}
+
+/******************************************************************************\
+ maps a PGM or PPM file and widens its bytes into an image in one pass, the
+ file is unmapped afterwards
+\******************************************************************************/
+template <class pType>
+static void mapPixels( const char fname[], ImageType<pType>& image )
+{
+	int N, M, Q;
+	int channels = ( pixelTraits<pType>::color ? 3 : 1 );
+	unsigned char *data;
+	MappedFile *file = mapFile( fname, pixelTraits<pType>::color, N, M, Q,
+	    data );
+
+	long rowBytes = (long)channels*sampleBytes(Q)*M;
 
+	try
+	{
+		checkLevels<pType>( fname, Q );
+		image.setImageInfo( N, M, Q, FILL_NONE );
+	}
+	catch ( string )
+	{
+		unmapFile( file );
+		throw;
+	}
+
+	for ( int i = 0; i < N; i++ )
+		unpackRow( data + i*rowBytes, image.getRow(i), M, Q );
+
+	unmapFile( file );
 }
 
+/******************************************************************************\
+ 8 bit images are laid out exactly like the file, so the image simply views
+ the mapped pages.  Nothing is read until a pixel is touched.  A 16 bit file
+ can't be viewed (or held) by an 8 bit image
+\******************************************************************************/
+template <class pType>
+static MappedFile* mapBytes( const char fname[], int& N, int& M, int& Q,
+	unsigned char *&data )
+{
+	MappedFile *file = mapFile( fname, pixelTraits<pType>::color, N, M, Q,
+	    data );
 
-void writeImage(const char fname[], ImageType<int>& image)
+	try
+	{
+		checkLevels<pType>( fname, Q );
+	}
+	catch ( string )
+	{
+		unmapFile( file );
+		throw;
+	}
+
+	return file;
+}
+
+void mapImage(const char fname[], ImageType<unsigned char>& image)
 {
-	int i, j;
 	int N, M, Q;
-	unsigned char *charImage;
-	string msg;
-	ofstream ofp;
+	unsigned char *data;
+	MappedFile *file = mapBytes<unsigned char>( fname, N, M, Q, data );
 
-	image.getImageInfo( N, M, Q );
+	image.setBuffer( data, N, M, Q, M, unmapFile, file );
+}
 
-	charImage = (unsigned char *) new unsigned char [M*N];
+void mapImage(const char fname[], ImageType<rgb8>& image)
+{
+	int N, M, Q;
+	unsigned char *data;
+	MappedFile *file = mapBytes<rgb8>( fname, N, M, Q, data );
 
-	// convert the integer values to unsigned char
+	image.setBuffer( reinterpret_cast<rgb8*>(data), N, M, Q, M, unmapFile,
+	    file );
+}
 
-	int val;
+void mapImage(const char fname[], ImageType<int>& image)
+{
+	mapPixels( fname, image );
+}
 
-	for( i=0; i<N; i++ )
-		for( j=0; j<M; j++ )
-		{
-			val = image.getPixelVal(i, j);
-			// clip values here
-			if ( val > Q ) val = Q;
-			if ( val < 0 ) val = 0;
-			charImage[i*M+j] = (unsigned char)val;
-		}
+void mapImage(const char fname[], ImageType<unsigned short>& image)
+{
+	mapPixels( fname, image );
+}
 
-	ofp.open( fname, ios::out | ios::binary );
+void mapImage(const char fname[], ImageType<rgb>& image)
+{
+	mapPixels( fname, image );
+}
 
-	if ( !ofp )
+void readImage(const char fname[], ImageType<int>& image)
+{
+	readPixels( fname, image );
+}
+
+void readImage(const char fname[], ImageType<unsigned char>& image)
+{
+	readPixels( fname, image );
+}
+
+void readImage(const char fname[], ImageType<unsigned short>& image)
+{
+	readPixels( fname, image );
+}
+
+void readImage(const char fname[], ImageType<rgb>& image)
+{
+	readPixels( fname, image );
+}
+
+void readImage(const char fname[], ImageType<rgb8>& image)
+{
+	readPixels( fname, image );
+}
+
+void readImage(const char fname[], PlanarImage<rgb>& image)
+{
+	readPlanes( fname, image );
+}
+
+void readImage(const char fname[], PlanarImage<rgb8>& image)
+{
+	readPlanes( fname, image );
+}
+
+void writeImage(const char fname[], ImageType<int>& image)
+{
+	writePixels( fname, image );
+}
+
+void writeImage(const char fname[], ImageType<unsigned char>& image)
+{
+	writePixels( fname, image );
+}
+
+void writeImage(const char fname[], ImageType<unsigned short>& image)
+{
+	writePixels( fname, image );
+}
+
+void writeImage(const char fname[], ImageType<rgb>& image)
+{
+	writePixels( fname, image );
+}
+
+void writeImage(const char fname[], ImageType<rgb8>& image)
+{
+	writePixels( fname, image );
+}
+
+void writeImage(const char fname[], PlanarImage<rgb>& image)
+{
+	writePlanes( fname, image );
+}
+
+void writeImage(const char fname[], PlanarImage<rgb8>& image)
+{
+	writePlanes( fname, image );
+}
+
+/******************************************************************************\
+                                  BandReader
+\******************************************************************************/
+
+/******************************************************************************\
+ opens the file and reads the header once, the position of the first pixel is
+ remembered so any band can be found with a single seek
+\******************************************************************************/
+BandReader::BandReader( const char fname[], int rows, int over )
+	: name( fname ), N( 0 ), M( 0 ), Q( 0 ), color( false ), bandRows( rows ),
+	  overlap( over ), next( 0 ), buffer( NULL )
+{
+	string msg;
+
+	if ( bandRows < 1 || overlap < 0 )
 	{
-		msg = "Can't open file: ";
+		msg = "Bad band size for image ";
 		msg += fname;
 		throw msg;
 	}
 
-	ofp << "P5" << endl;
-	ofp << M << " " << N << endl;
-	ofp << Q << endl;
+	openAnyImage( fname, ifp, color, N, M, Q );
+	dataStart = ifp.tellg();
 
-	ofp.write( reinterpret_cast<char *>(charImage), (M*N)*sizeof(unsigned char) );
+	// no band is ever taller than this
+	buffer = new unsigned char [(long)( bandRows + 2*overlap ) *
+	    ( color ? 3 : 1 ) * sampleBytes( Q ) * M];
+}
 
-	if ( ofp.fail() )
+BandReader::~BandReader()
+{
+	delete [] buffer;
+}
+
+void BandReader::getImageInfo( int& rows, int& cols, int& levels ) const
+{
+	rows = N;
+	cols = M;
+	levels = Q;
+}
+
+bool BandReader::isColor() const
+{
+	return color;
+}
+
+void BandReader::rewind()
+{
+	next = 0;
+}
+
+/******************************************************************************\
+ the band covers the file rows [top,bottom), the core rows are [next,last)
+\******************************************************************************/
+template <class pType>
+bool BandReader::readBand( ImageType<pType>& band, int& first, int& count )
+{
+	string msg;
+	int channels = ( color ? 3 : 1 );
+
+	if ( next >= N )
+		return false;
+
+	if ( pixelTraits<pType>::color != color )
 	{
-		msg = "Can't write image ";
-		msg += fname;
+		msg = "Image ";
+		msg += name;
+		msg += ( color ? " is not PGM" : " is not PPM" );
 		throw msg;
 	}
 
-	ofp.close();
+	checkLevels<pType>( name.c_str(), Q );
 
-	delete [] charImage;
+	int top = max( next - overlap, 0 );
+	int last = min( next + bandRows, N );
+	int bottom = min( last + overlap, N );
+	long rowBytes = (long)channels * sampleBytes( Q ) * M;
+
+	ifp.clear();
+	ifp.seekg( dataStart + (streamoff)( top * rowBytes ) );
+	ifp.read( reinterpret_cast<char *>(buffer), ( bottom - top ) * rowBytes );
+
+	if ( ifp.fail() )
+	{
+		msg = "Image ";
+		msg += name;
+		msg += " has wrong size";
+		throw msg;
+	}
+
+	band.setImageInfo( bottom - top, M, Q, FILL_NONE );
+
+	for ( int i = 0; i < bottom - top; i++ )
+		unpackRow( buffer + i*rowBytes, band.getRow(i), M, Q );
+
+	first = next - top;
+	count = last - next;
+	next = last;
+
+	return true;
 }
 
-void writeImage(const char fname[], ImageType<rgb>& image)
-{
-	int i, j;
-	int N, M, Q;
-	unsigned char *charImage;
-	string msg;
-	ofstream ofp;
+template bool BandReader::readBand( ImageType<int>&, int&, int& );
+template bool BandReader::readBand( ImageType<unsigned char>&, int&, int& );
+template bool BandReader::readBand( ImageType<unsigned short>&, int&, int& );
+template bool BandReader::readBand( ImageType<rgb>&, int&, int& );
+template bool BandReader::readBand( ImageType<rgb8>&, int&, int& );
 
-	image.getImageInfo(N, M, Q);
+/******************************************************************************\
+                                  BandWriter
+\******************************************************************************/
 
-	charImage = (unsigned char *) new unsigned char [3*M*N];
+BandWriter::BandWriter( const char fname[], int rows, int cols, int levels,
+	bool isColor )
+	: name( fname ), N( rows ), M( cols ), Q( levels ), color( isColor ),
+	  written( 0 ), buffer( NULL )
+{
+	createImage( fname, ofp, N, M, Q, ( color ? 3 : 1 ) );
+	buffer = new unsigned char [( color ? 3 : 1 ) * sampleBytes( Q ) * M];
+}
 
-	rgb val;
+// an unfinished file is simply left short, destructors don't throw
+BandWriter::~BandWriter()
+{
+	delete [] buffer;
+}
 
-	for(i=0; i<N; i++)
-		for(j=0; j<3*M; j+=3)
-		{
-			val = image.getPixelVal(i, j/3);
-			if ( val.r > Q ) val.r = Q;
-			if ( val.g > Q ) val.g = Q;
-			if ( val.b > Q ) val.b = Q;
-			if ( val.r < 0 ) val.r = 0;
-			if ( val.g < 0 ) val.g = 0;
-			if ( val.b < 0 ) val.b = 0;
-			charImage[i*3*M+j]=(unsigned char)val.r;
-			charImage[i*3*M+j+1]=(unsigned char)val.g;
-			charImage[i*3*M+j+2]=(unsigned char)val.b;
-		}
+template <class pType>
+void BandWriter::writeRows( const ImageType<pType>& band, int first,
+	int count )
+{
+	int rows, cols, levels;
+	string msg;
 
-	ofp.open(fname, ios::out | ios::binary);
+	band.getImageInfo( rows, cols, levels );
 
-	if (!ofp)
+	if ( pixelTraits<pType>::color != color || cols != M ||
+	     first < 0 || count < 0 || first + count > rows )
 	{
-		msg = "Can't open file: ";
-		msg += fname;
+		msg = "Band doesn't match image ";
+		msg += name;
 		throw msg;
 	}
 
-	ofp << "P6" << endl;
-	ofp << M << " " << N << endl;
-	ofp << Q << endl;
+	if ( written + count > N )
+	{
+		msg = "Too many rows written to image ";
+		msg += name;
+		throw msg;
+	}
 
-	ofp.write( reinterpret_cast<char *>(charImage), (3*M*N)*sizeof(unsigned char));
+	for ( int i = first; i < first + count; i++ )
+	{
+		packRow( band.getRow(i), buffer, M, Q );
+		ofp.write( reinterpret_cast<const char *>(buffer),
+		    ( color ? 3 : 1 ) * sampleBytes( Q ) * M );
+	}
 
-	if (ofp.fail())
+	if ( ofp.fail() )
 	{
 		msg = "Can't write image ";
-		msg += fname;
+		msg += name;
 		throw msg;
 	}
 
+	written += count;
+}
+
+template void BandWriter::writeRows( const ImageType<int>&, int, int );
+template void BandWriter::writeRows( const ImageType<unsigned char>&, int,
+	int );
+template void BandWriter::writeRows( const ImageType<unsigned short>&, int,
+	int );
+template void BandWriter::writeRows( const ImageType<rgb>&, int, int );
+template void BandWriter::writeRows( const ImageType<rgb8>&, int, int );
+
+void BandWriter::close()
+{
+	string msg;
+
 	ofp.close();
 
-	delete [] charImage;
+	if ( written != N || ofp.fail() )
+	{
+		msg = "Can't write image ";
+		msg += name;
+		throw msg;
+	}
 }
-
@@ -9,7 +9,9 @@
 	#include <fstream>
 	#include <stdlib.h>
 	#include <stdio.h>
+	#include <string>
 	#include "image.h"
+	#include "planarImage.h"
 
 	// name : readImageHeader
 	// input : cstring of filename, int N, M, Q and bool value to hold image data
@@ -19,17 +21,134 @@
 
 	// name : readImage
 	// input : cstring of filename, and ImageType object to hold image data
-	// output : set image info to the ImageType object
+	// output : set image info to the ImageType object, the grayscale
+	//          versions read .pgm files and the color versions read .ppm.
+	//          Files with Q above 255 (two bytes per sample) can be read
+	//          into every type except unsigned char and rgb8
 	// dependencies : image.h
 	void readImage( const char[], ImageType<int>& );
+	void readImage( const char[], ImageType<unsigned char>& );
+	void readImage( const char[], ImageType<unsigned short>& );
 	void readImage( const char[], ImageType<rgb>& );
+	void readImage( const char[], ImageType<rgb8>& );
+
+	// reads a .ppm file straight into the planes of a PlanarImage, each row
+	// is split into channels as it is converted
+	void readImage( const char[], PlanarImage<rgb>& );
+	void readImage( const char[], PlanarImage<rgb8>& );
+
+	// name : mapImage
+	// input : cstring of filename, and ImageType object to hold image data
+	// output : maps the .pgm (grayscale) or .ppm (color) file into memory
+	//          and parses the header only once.  unsigned char and rgb8
+	//          images view the mapped pages directly (no copy is made, and
+	//          changes to the image never reach the file), the other types
+	//          are widened from the mapping in a single pass
+	// dependencies : image.h
+	void mapImage( const char[], ImageType<int>& );
+	void mapImage( const char[], ImageType<unsigned char>& );
+	void mapImage( const char[], ImageType<unsigned short>& );
+	void mapImage( const char[], ImageType<rgb>& );
+	void mapImage( const char[], ImageType<rgb8>& );
 
 	// name : writeImage
 	// input : cstring of filename, and ImageType object to be store in file
-	// output : writes a pgm type file with ImageType stored as a RAW form
+	// output : writes a pgm type file with ImageType stored as a RAW form,
+	//          samples are two bytes each when Q is above 255 (Q can be at
+	//          most 65535)
 	// dependencies : image.h
 	void writeImage( const char[], ImageType<int>& );
+	void writeImage( const char[], ImageType<unsigned char>& );
+	void writeImage( const char[], ImageType<unsigned short>& );
 	void writeImage( const char[], ImageType<rgb>& );
+	void writeImage( const char[], ImageType<rgb8>& );
+
+	// writes the planes of a PlanarImage as a .ppm file, each row is
+	// interleaved as it is converted
+	void writeImage( const char[], PlanarImage<rgb>& );
+	void writeImage( const char[], PlanarImage<rgb8>& );
+
+	// name : BandReader
+	// input : cstring of filename, rows per band and rows of overlap
+	// output : streams a .pgm or .ppm file as horizontal bands so images
+	//          taller than memory can be processed.  Only one band (and a
+	//          one band buffer of bytes) is ever held in memory.  Each band
+	//          holds up to "rows per band" core rows plus up to "overlap"
+	//          rows above and below them (fewer at the top and bottom of
+	//          the image) so neighbourhood operations see the same pixels
+	//          they would in the whole image
+	// dependencies : image.h
+	class BandReader
+	{
+	public:
+		BandReader( const char[], int, int = 0 );
+		~BandReader();
+
+		// sets N, M and Q of the whole image
+		void getImageInfo( int&, int&, int& ) const;
+
+		// true for .ppm files
+		bool isColor() const;
+
+		// reads the next band into the image (resizing it), first is set
+		// to the band row of the first core row and count to the number
+		// of core rows.  Returns false once every row has been read.  The
+		// pixel type must be grayscale for .pgm and color for .ppm files
+		template <class pType>
+		bool readBand( ImageType<pType>&, int&, int& );
+
+		// starts reading from the top of the image again
+		void rewind();
+
+	private:
+		// not copyable, both would read from the same file
+		BandReader( const BandReader& );
+		BandReader& operator=( const BandReader& );
+
+		string name;			// file name, for error messages
+		ifstream ifp;			// the open file
+		streampos dataStart;	// offset of the first pixel byte
+		int N, M, Q;			// size of the whole image
+		bool color;				// .ppm file
+		int bandRows;			// core rows per band
+		int overlap;			// extra rows above and below the core
+		int next;				// first core row of the next band
+		unsigned char *buffer;	// bytes of one band
+	};
+
+	// name : BandWriter
+	// input : cstring of filename, N, M, Q of the whole image and true for
+	//         a .ppm (color) file
+	// output : writes the header, then rows are appended a band at a time
+	//          with writeRows (clipped to [0,Q]).  close checks that exactly
+	//          N rows were written
+	// dependencies : image.h
+	class BandWriter
+	{
+	public:
+		BandWriter( const char[], int, int, int, bool );
+		~BandWriter();
+
+		// appends count rows of the image starting at row first, the image
+		// must have M columns and match the color of the file
+		template <class pType>
+		void writeRows( const ImageType<pType>&, int, int );
+
+		// finishes the file
+		void close();
+
+	private:
+		// not copyable, both would write to the same file
+		BandWriter( const BandWriter& );
+		BandWriter& operator=( const BandWriter& );
+
+		string name;			// file name, for error messages
+		ofstream ofp;			// the open file
+		int N, M, Q;			// size of the whole image
+		bool color;				// .ppm file
+		int written;			// rows written so far
+		unsigned char *buffer;	// bytes of one row
+	};
 
 #endif
 
@@ -0,0 +1,193 @@
+#include <string>
+#include <cstring>
+#include <algorithm>
+#include "morphology.h"
+#include "pixelKernels.h"
+#include "parallel.h"
+
+using namespace std;
+
+/******************************************************************************\
+ default constructor, the 3x3 square
+\******************************************************************************/
+StructuringElement::StructuringElement()
+	: rows( 3 ), cols( 3 ), crossShape( false )
+{
+}
+
+StructuringElement::StructuringElement( int r, int c, bool isCross )
+	: rows( r ), cols( c ), crossShape( isCross )
+{
+	if ( rows < 1 || cols < 1 )
+		throw (string)"A structuring element needs a size of at least 1!";
+}
+
+StructuringElement StructuringElement::square( int k )
+{
+	return StructuringElement( k, k, false );
+}
+
+StructuringElement StructuringElement::rectangle( int r, int c )
+{
+	return StructuringElement( r, c, false );
+}
+
+StructuringElement StructuringElement::horizontalLine( int k )
+{
+	return StructuringElement( 1, k, false );
+}
+
+StructuringElement StructuringElement::verticalLine( int k )
+{
+	return StructuringElement( k, 1, false );
+}
+
+StructuringElement StructuringElement::cross( int k )
+{
+	return StructuringElement( k, k, true );
+}
+
+int StructuringElement::getRows() const
+{
+	return rows;
+}
+
+int StructuringElement::getCols() const
+{
+	return cols;
+}
+
+bool StructuringElement::isCross() const
+{
+	return crossShape;
+}
+
+/******************************************************************************\
+ a rectangle spreads along the rows into a second mask and back down the
+ columns, a cross spreads the original both ways and keeps the larger.  A
+ line of 1 leaves the mask alone so its pass is skipped
+\******************************************************************************/
+void StructuringElement::spread( vector<unsigned char>& mask, int N, int M )
+	const
+{
+	if ( ( rows == 1 && cols == 1 ) || N == 0 || M == 0 )
+		return;
+
+	vector<unsigned char> across( mask.size() );
+
+	if ( crossShape )
+	{
+		vector<unsigned char> down( mask.size() );
+
+		spreadRows( &mask[0], &across[0], N, M, cols );
+		spreadColumns( &mask[0], &down[0], N, M, rows );
+		maxSamples( &across[0], &down[0], &mask[0], (long)N * M );
+	}
+	else if ( rows == 1 )
+	{
+		spreadRows( &mask[0], &across[0], N, M, cols );
+		mask.swap( across );
+	}
+	else if ( cols == 1 )
+	{
+		spreadColumns( &mask[0], &across[0], N, M, rows );
+		mask.swap( across );
+	}
+	else
+	{
+		spreadRows( &mask[0], &across[0], N, M, cols );
+		spreadColumns( &across[0], &mask[0], N, M, rows );
+	}
+}
+
+/******************************************************************************\
+ the line p has k-1 padding entries, ( k-1 )/2 before and k/2 after, so
+ out[j] is the max of p[j] to p[j+k-1].  g is the max from the start of each
+ block of k up to an entry and h the max from an entry to the end of its
+ block, the k entries from j are the end of j's block and the start of the
+ next so out[j] is the larger of h[j] and g[j+k-1]
+\******************************************************************************/
+static void runningMax( const unsigned char p[], unsigned char g[],
+	unsigned char h[], unsigned char out[], int n, int k )
+{
+	const int L = n + k - 1;
+
+	for ( int start = 0; start < L; start += k )
+	{
+		int end = min( start + k, L );
+
+		g[start] = p[start];
+		for ( int t = start + 1; t < end; t++ )
+			g[t] = max( g[t-1], p[t] );
+
+		h[end-1] = p[end-1];
+		for ( int t = end - 2; t >= start; t-- )
+			h[t] = max( h[t+1], p[t] );
+	}
+
+	for ( int j = 0; j < n; j++ )
+		out[j] = max( h[j], g[j+k-1] );
+}
+
+void spreadRows( const unsigned char mask[], unsigned char out[], int N,
+	int M, int k )
+{
+	const int before = ( k-1 ) / 2;
+	const int L = M + k - 1;
+
+	parallelFor( N, 16, [&]( int first, int last )
+	{
+		// the padding is zeroed once, only the middle changes per row
+		vector<unsigned char> p( L, 0 ), g( L ), h( L );
+
+		for ( int i = first; i < last; i++ )
+		{
+			memcpy( &p[before], mask + (long)i*M, M );
+			runningMax( &p[0], &g[0], &h[0], out + (long)i*M, M, k );
+		}
+	} );
+}
+
+/******************************************************************************\
+ the same blocks down the columns, with whole rows as the entries so every
+ max is a run of maxSamples.  The blocks don't depend on each other and are
+ worked out in parallel, then every output row is one more maxSamples.  The
+ padding rows all point at one row of zeros
+\******************************************************************************/
+void spreadColumns( const unsigned char mask[], unsigned char out[], int N,
+	int M, int k )
+{
+	const int before = ( k-1 ) / 2;
+	const int L = N + k - 1;
+	vector<unsigned char> zero( M, 0 ), g( (long)L * M ), h( (long)L * M );
+
+	auto line = [&]( int t ) -> const unsigned char*
+	{
+		int i = t - before;
+		return ( i >= 0 && i < N ) ? mask + (long)i*M : &zero[0];
+	};
+	auto G = [&]( int t ) { return &g[(long)t*M]; };
+	auto H = [&]( int t ) { return &h[(long)t*M]; };
+
+	parallelFor( ( L + k - 1 ) / k, 1, [&]( int first, int last )
+	{
+		for ( int b = first; b < last; b++ )
+		{
+			int start = b * k, end = min( start + k, L );
+
+			memcpy( G( start ), line( start ), M );
+			for ( int t = start + 1; t < end; t++ )
+				maxSamples( G( t-1 ), line( t ), G( t ), M );
+
+			memcpy( H( end-1 ), line( end-1 ), M );
+			for ( int t = end - 2; t >= start; t-- )
+				maxSamples( H( t+1 ), line( t ), H( t ), M );
+		}
+	} );
+
+	parallelFor( N, 16, [&]( int first, int last )
+	{
+		for ( int j = first; j < last; j++ )
+			maxSamples( H( j ), G( j+k-1 ), out + (long)j*M, M );
+	} );
+}
@@ -0,0 +1,66 @@
+/******************************************************************************\
+ StructuringElement is the neighbourhood ImageType::erode and dilate look at:
+ a rectangle (squares and horizontal or vertical lines are rectangles) or a
+ cross of a horizontal and a vertical line.  A pixel is in the middle of its
+ neighbourhood, for an even size it's the lower of the two middle pixels, so
+ a line of 4 reaches 1 before the pixel and 2 after it.
+
+ Erode and dilate mark the pixels that are 0 (or Q) in a mask of bytes and
+ spread the marks over the element, which is a running max of the mask.
+ The max over a line of k is done with the van Herk/Gil-Werman method: the
+ line is cut into blocks of k, and a max from the start of each block and
+ one from its end are kept, so any k entries in a row are covered by the end
+ of one block and the start of the next and every entry costs 3 maxes
+ whatever k is.  A rectangle is a pass along the rows and then one down the
+ columns, a cross is the two passes on the original mask put together.  The
+ lines are padded with k-1 zeros so the inner loops never check bounds.
+\******************************************************************************/
+
+#ifndef MORPHOLOGY_H
+#define MORPHOLOGY_H
+
+#include <vector>
+
+class StructuringElement
+{
+public:
+	// default constructor, the 3x3 square erode() and dilate() have always
+	// used
+	StructuringElement();
+
+	// name : square, rectangle, horizontalLine, verticalLine, cross
+	// input : the size (rows and columns for a rectangle)
+	// output : the element, throws a string for a size below 1
+	static StructuringElement square( int );
+	static StructuringElement rectangle( int, int );
+	static StructuringElement horizontalLine( int );
+	static StructuringElement verticalLine( int );
+	static StructuringElement cross( int );
+
+	int getRows() const;
+	int getCols() const;
+	bool isCross() const;
+
+	// name : spread
+	// input : a mask of rows x cols bytes (0 or 1), rows and cols
+	// output : sets every entry to 1 if any entry under the element around
+	//          it is 1, entries outside the mask count as 0
+	void spread( std::vector<unsigned char>&, int, int ) const;
+
+private:
+	StructuringElement( int, int, bool );
+
+	int rows;
+	int cols;
+	bool crossShape;	// only the lines through the middle of the rectangle
+};
+
+// name : spreadRows, spreadColumns
+// input : a mask of rows x cols bytes, an array of the same size, rows, cols
+//         and the length k of the line
+// output : each entry of the array is the max of the k entries of the mask
+//          along its row (or column) around it
+void spreadRows( const unsigned char[], unsigned char[], int, int, int );
+void spreadColumns( const unsigned char[], unsigned char[], int, int, int );
+
+#endif
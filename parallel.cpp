@@ -0,0 +1,208 @@
+#include "parallel.h"
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
+#include <algorithm>
+
+using namespace std;
+
+/******************************************************************************\
+ the pool's workers sleep until a new job (generation) is posted, then take
+ bands off the job until none are left.  The job isn't finished until every
+ worker has seen it, so a late worker can never pick up the next one's bands
+\******************************************************************************/
+class ThreadPool
+{
+public:
+	ThreadPool() : generation( 0 ), stopping( false ), busy( 0 ) {}
+	~ThreadPool() { resize( 0 ); }
+
+	// number of threads besides the caller
+	int size() const { return workers.size(); }
+
+	// stops the current workers and starts count new ones
+	void resize( int );
+
+	// runs func over [0,items) in bands of chunk rows
+	void run( int, int, const function<void(int,int)>& );
+
+	// set while a thread is running bands, the pool's own threads and the
+	// caller helping out, a parallelFor from inside a band must not touch
+	// the pool (the caller already holds use)
+	static thread_local bool inJob;
+
+	// only one job may use the pool at a time
+	mutex use;
+
+private:
+	void work( int );
+	void runBands();
+
+	vector<thread> workers;
+
+	mutex lock;						// guards everything below
+	condition_variable posted;		// a new job or stopping
+	condition_variable finished;	// a worker finished the job
+	int generation;					// number of jobs posted
+	bool stopping;
+	int busy;						// workers still on the job
+
+	const function<void(int,int)> *func;
+	int items, chunk;
+	atomic<int> next;				// first row of the next band
+	exception_ptr error;			// first exception thrown by a band
+};
+
+thread_local bool ThreadPool::inJob = false;
+
+static ThreadPool pool;
+static atomic<int> threadSetting( 0 );
+
+void ThreadPool::resize( int count )
+{
+	{
+		lock_guard<mutex> guard( lock );
+		stopping = true;
+	}
+	posted.notify_all();
+
+	for ( size_t i = 0; i < workers.size(); i++ )
+		workers[i].join();
+	workers.clear();
+
+	stopping = false;
+
+	// workers start from the current job, one posted before a new thread
+	// gets going still counts as new to it
+	for ( int i = 0; i < count; i++ )
+		workers.push_back( thread( &ThreadPool::work, this, generation ) );
+}
+
+void ThreadPool::runBands()
+{
+	while ( true )
+	{
+		int first = next.fetch_add( chunk );
+		if ( first >= items )
+			return;
+
+		try
+		{
+			(*func)( first, min( first + chunk, items ) );
+		}
+		catch ( ... )
+		{
+			lock_guard<mutex> guard( lock );
+			if ( !error )
+				error = current_exception();
+		}
+	}
+}
+
+void ThreadPool::work( int seen )
+{
+	unique_lock<mutex> guard( lock );
+
+	inJob = true;
+
+	while ( true )
+	{
+		while ( !stopping && generation == seen )
+			posted.wait( guard );
+
+		if ( stopping )
+			return;
+
+		seen = generation;
+
+		guard.unlock();
+		runBands();
+		guard.lock();
+
+		if ( --busy == 0 )
+			finished.notify_all();
+	}
+}
+
+void ThreadPool::run( int count, int rows, const function<void(int,int)>& f )
+{
+	exception_ptr thrown;
+
+	{
+		lock_guard<mutex> guard( lock );
+		func = &f;
+		items = count;
+		chunk = rows;
+		next = 0;
+		error = nullptr;
+		busy = workers.size();
+		generation++;
+	}
+	posted.notify_all();
+
+	// the caller takes bands as well
+	inJob = true;
+	runBands();
+	inJob = false;
+
+	{
+		unique_lock<mutex> guard( lock );
+		while ( busy > 0 )
+			finished.wait( guard );
+		thrown = error;
+	}
+
+	if ( thrown )
+		rethrow_exception( thrown );
+}
+
+void setThreads( int count )
+{
+	threadSetting = max( count, 0 );
+}
+
+int getThreads()
+{
+	int count = threadSetting;
+
+	if ( count == 0 )
+		count = max( 1u, thread::hardware_concurrency() );
+
+	return count;
+}
+
+/******************************************************************************\
+ bands are made about four to a thread so a band that is slower than the rest
+ (rows of a rotation that are mostly background are quick) doesn't hold
+ everything up, but never smaller than minRows
+\******************************************************************************/
+void parallelFor( int rows, int minRows, const function<void(int,int)>& f )
+{
+	int threads = getThreads();
+
+	if ( rows <= 0 )
+		return;
+
+	if ( threads <= 1 || rows <= minRows || ThreadPool::inJob )
+	{
+		f( 0, rows );
+		return;
+	}
+
+	unique_lock<mutex> guard( pool.use, try_to_lock );
+
+	// someone else has the pool, do the work here instead of waiting
+	if ( !guard.owns_lock() )
+	{
+		f( 0, rows );
+		return;
+	}
+
+	if ( pool.size() != threads - 1 )
+		pool.resize( threads - 1 );
+
+	pool.run( rows, max( max( minRows, 1 ), rows / ( threads*4 ) ), f );
+}
@@ -0,0 +1,34 @@
+/******************************************************************************\
+ A small pool of threads for splitting the rows of an image operation across
+ processors.  parallelFor cuts a range of rows into contiguous bands and runs
+ them on the pool (the calling thread works on bands too), then returns once
+ every band is done.  Each row is still worked out by exactly the same code,
+ so the results don't depend on how many threads there are.
+
+ The pool runs one parallelFor at a time, a call made while it is busy (or
+ from inside one of its bands) simply runs on the calling thread.
+\******************************************************************************/
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <functional>
+
+// name : setThreads
+// input : number of threads image operations may use, 0 uses one per
+//         processor and 1 turns threading off
+// output : the pool is resized the next time it is used
+void setThreads( int );
+
+// name : getThreads
+// output : returns the number of threads image operations will use
+int getThreads();
+
+// name : parallelFor
+// input : number of rows, the fewest rows worth handing to a thread, and a
+//         function that does the rows [first,last)
+// output : runs the function over every row, any exception thrown by it is
+//          re-thrown here once all the bands have finished
+void parallelFor( int, int, const std::function<void(int,int)>& );
+
+#endif
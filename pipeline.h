@@ -0,0 +1,443 @@
+/******************************************************************************\
+ ImagePipeline records a chain of ImageType operations and runs the whole
+ chain over an image with as few passes over it as it can:
+
+   - point operations in a row (negate, threshold, gamma, stretch or any
+     PointMap) are combined into one PointMap, so they cost one lookup
+   - erode and dilate in a row, along with any point operations between
+     them, stream down the image in one pass.  Each step keeps a ring of
+     the last three rows it made, a row of a step is made as soon as the
+     rows around it in the step before are ready, so nothing the size of the
+     image is ever copied
+   - anything else (apply) is run on the whole image between the fused
+     passes
+
+ The results are exactly the same as calling each operation on the image in
+ turn.  The streaming pass is split into bands of rows for the thread pool,
+ each band starts a few rows early to fill its rings and keeps copies of the
+ rows its neighbours will overwrite.
+\******************************************************************************/
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <vector>
+#include <functional>
+#include "image.h"
+
+template <class pType>
+class ImagePipeline
+{
+public:
+	typedef typename pixelTraits<pType>::channel channel;
+
+	// number of channels in a pixel
+	static const int C = pixelTraits<pType>::color ? 3 : 1;
+
+	// point operations, the same as the ImageType functions of the same name
+	ImagePipeline& negateImage();
+	ImagePipeline& threshold( pType );
+	ImagePipeline& gammaImage( double );
+	ImagePipeline& stretchImage( int, int );
+
+	// any PointMap, it has to be made for the Q of the image the pipeline is
+	// run on
+	ImagePipeline& map( const PointMap& );
+
+	// the 3x3 erode and dilate of ImageType
+	ImagePipeline& erode();
+	ImagePipeline& dilate();
+
+	// any other operation, run on the whole image
+	ImagePipeline& apply( const std::function<void( ImageType<pType>& )>& );
+
+	// number of operations recorded
+	int size() const;
+
+	// forget every operation
+	void clear();
+
+	// name : run
+	// input : an image
+	// output : does every operation to the image in order, throws a string if
+	//          a PointMap passed to map doesn't match it
+	void run( ImageType<pType>& ) const;
+
+private:
+	enum StepType { STEP_POINT, STEP_ERODE, STEP_DILATE, STEP_IMAGE };
+
+	struct Step
+	{
+		StepType type;
+
+		// the map of a point step for Q and C
+		std::function<PointMap( int, int )> point;
+
+		// the operation of an image step
+		std::function<void( ImageType<pType>& )> image;
+	};
+
+	// an erode or dilate and the map of the point steps after it
+	struct Stage
+	{
+		int value;			// 0 for erode, Q for dilate
+		bool mapped;
+		PointMap after;
+	};
+
+	ImagePipeline& addPoint( const std::function<PointMap( int, int )>& );
+	ImagePipeline& addStep( StepType );
+
+	// the map of a point step with its results saturated to the pixel type,
+	// so combined maps give what running them one at a time would
+	static PointMap clipped( const PointMap& );
+
+	// runs the steps [first,last), which are all point, erode or dilate
+	void runFused( ImageType<pType>&, int, int ) const;
+
+	// runs the stages over the rows [b0,b1) of the image
+	void runBand( ImageType<pType>&, const std::vector<Stage>&, bool,
+	    const PointMap&, int, int, const std::vector<pType>&,
+	    const std::vector<pType>& ) const;
+
+	// one row of an erode (value 0) or dilate (value Q), up and down are
+	// NULL outside the image.  hit needs M+2 entries
+	static void morphRow( const pType*, const pType*, const pType*, pType*,
+	    int, int, std::vector<char>& );
+
+	std::vector<Step> steps;
+};
+
+template <class pType>
+ImagePipeline<pType>& ImagePipeline<pType>::addPoint(
+	const std::function<PointMap( int, int )>& point )
+{
+	Step step;
+
+	step.type = STEP_POINT;
+	step.point = point;
+	steps.push_back( step );
+
+	return *this;
+}
+
+template <class pType>
+ImagePipeline<pType>& ImagePipeline<pType>::addStep( StepType type )
+{
+	Step step;
+
+	step.type = type;
+	steps.push_back( step );
+
+	return *this;
+}
+
+template <class pType>
+ImagePipeline<pType>& ImagePipeline<pType>::negateImage()
+{
+	return addPoint( []( int Q, int channels )
+	{
+		return PointMap::negate( Q, channels );
+	} );
+}
+
+/******************************************************************************\
+ a color pixel is thresholded as a whole, so only grayscale thresholds are
+ point steps
+\******************************************************************************/
+template <class pType>
+ImagePipeline<pType>& ImagePipeline<pType>::threshold( pType L )
+{
+	if ( pixelTraits<pType>::color )
+		return apply( [L]( ImageType<pType>& img ) { img.threshold( L ); } );
+
+	int level = toInt( L );
+
+	return addPoint( [level]( int Q, int channels )
+	{
+		return PointMap::threshold( Q, channels, level );
+	} );
+}
+
+template <class pType>
+ImagePipeline<pType>& ImagePipeline<pType>::gammaImage( double g )
+{
+	return addPoint( [g]( int Q, int channels )
+	{
+		return PointMap::gamma( Q, channels, g );
+	} );
+}
+
+template <class pType>
+ImagePipeline<pType>& ImagePipeline<pType>::stretchImage( int low, int high )
+{
+	return addPoint( [low, high]( int Q, int channels )
+	{
+		return PointMap::stretch( Q, channels, low, high );
+	} );
+}
+
+template <class pType>
+ImagePipeline<pType>& ImagePipeline<pType>::map( const PointMap& m )
+{
+	return addPoint( [m]( int Q, int channels )
+	{
+		if ( m.getLevels() != Q || m.getChannels() != channels )
+			throw (string)"Point map doesn't match the image!";
+		return m;
+	} );
+}
+
+template <class pType>
+ImagePipeline<pType>& ImagePipeline<pType>::erode()
+{
+	return addStep( STEP_ERODE );
+}
+
+template <class pType>
+ImagePipeline<pType>& ImagePipeline<pType>::dilate()
+{
+	return addStep( STEP_DILATE );
+}
+
+template <class pType>
+ImagePipeline<pType>& ImagePipeline<pType>::apply(
+	const std::function<void( ImageType<pType>& )>& op )
+{
+	Step step;
+
+	step.type = STEP_IMAGE;
+	step.image = op;
+	steps.push_back( step );
+
+	return *this;
+}
+
+template <class pType>
+int ImagePipeline<pType>::size() const
+{
+	return steps.size();
+}
+
+template <class pType>
+void ImagePipeline<pType>::clear()
+{
+	steps.clear();
+}
+
+template <class pType>
+PointMap ImagePipeline<pType>::clipped( const PointMap& m )
+{
+	typedef pixelTraits<channel> channelTraits;
+
+	return PointMap( m.getLevels(), m.getChannels(), [m]( int value, int c )
+	{
+		return (int)channelTraits::narrow( m.map( value, c ) );
+	} );
+}
+
+template <class pType>
+void ImagePipeline<pType>::run( ImageType<pType>& img ) const
+{
+	int first = 0;
+
+	// every run of steps up to an image step is done in one fused pass
+	for ( int k = 0; k <= (int)steps.size(); k++ )
+		if ( k == (int)steps.size() || steps[k].type == STEP_IMAGE )
+		{
+			if ( k > first )
+				runFused( img, first, k );
+			if ( k < (int)steps.size() )
+				steps[k].image( img );
+			first = k + 1;
+		}
+}
+
+/******************************************************************************\
+ the point steps before the first erode or dilate become one map applied to
+ the rows as they are read, the point steps after each erode or dilate
+ become a map applied to the rows it makes
+\******************************************************************************/
+template <class pType>
+void ImagePipeline<pType>::runFused( ImageType<pType>& img, int first,
+	int last ) const
+{
+	int N, M, Q;
+	bool mapped = false;
+	PointMap before;
+	std::vector<Stage> stages;
+
+	img.getImageInfo( N, M, Q );
+
+	for ( int k = first; k < last; k++ )
+	{
+		const Step& step = steps[k];
+
+		if ( step.type == STEP_POINT )
+		{
+			PointMap m = clipped( step.point( Q, C ) );
+			bool& has = stages.empty() ? mapped : stages.back().mapped;
+			PointMap& to = stages.empty() ? before : stages.back().after;
+
+			to = has ? to.then( m ) : m;
+			has = true;
+		}
+		else
+		{
+			Stage stage;
+
+			stage.value = ( step.type == STEP_ERODE ? 0 : Q );
+			stage.mapped = false;
+			stages.push_back( stage );
+		}
+	}
+
+	// nothing but point steps, one lookup per pixel in place
+	if ( stages.empty() )
+	{
+		img.applyMap( before );
+		return;
+	}
+
+	if ( N == 0 || M == 0 )
+		return;
+
+	int K = stages.size();
+	int bands = std::max( 1, std::min( getThreads(), N / ( 8*K + 8 ) ) );
+	std::vector< std::vector<pType> > above( bands ), below( bands );
+
+	// a band reads K rows past each of its ends, which the bands next to it
+	// may have already overwritten, so those are copied first
+	for ( int b = 0; b < bands; b++ )
+	{
+		int b0 = (long)N * b / bands, b1 = (long)N * ( b+1 ) / bands;
+
+		for ( int i = std::max( b0 - K, 0 ); i < b0; i++ )
+			above[b].insert( above[b].end(), img.getRow(i),
+			    img.getRow(i) + M );
+		for ( int i = b1; i < std::min( b1 + K, N ); i++ )
+			below[b].insert( below[b].end(), img.getRow(i),
+			    img.getRow(i) + M );
+	}
+
+	parallelFor( bands, 1, [&]( int firstBand, int lastBand )
+	{
+		for ( int b = firstBand; b < lastBand; b++ )
+			runBand( img, stages, mapped, before, (long)N * b / bands,
+			    (long)N * ( b+1 ) / bands, above[b], below[b] );
+	} );
+}
+
+/******************************************************************************\
+ level 0 is the image as read (through the first map), level s is the
+ output of stage s.  Levels below K keep their last three rows in a ring,
+ row r in slot r % 3.  Once row r of a level is in, the next level can make
+ row r-1 (and row r too at the bottom of the image).  Level K is written
+ straight back into the image, by then every row of the image it could still
+ need has already been read into level 0
+\******************************************************************************/
+template <class pType>
+void ImagePipeline<pType>::runBand( ImageType<pType>& img,
+	const std::vector<Stage>& stages, bool mapped, const PointMap& before,
+	int b0, int b1, const std::vector<pType>& above,
+	const std::vector<pType>& below ) const
+{
+	int N, M, Q;
+	int K = stages.size();
+
+	img.getImageInfo( N, M, Q );
+
+	std::vector< std::vector<pType> > ring( K * 3, std::vector<pType>( M ) );
+	std::vector< RowMap<pType> > maps;
+	std::vector<char> hit( M + 2 );
+
+	// the maps in the pixel type, an identity takes the place of a stage
+	// without one so the indexes line up
+	maps.push_back( RowMap<pType>( mapped ? before :
+	    PointMap::identity( 0, C ) ) );
+	for ( int s = 0; s < K; s++ )
+		maps.push_back( RowMap<pType>( stages[s].mapped ? stages[s].after :
+		    PointMap::identity( 0, C ) ) );
+
+	// rows level s needs are [b0 - (K-s), b1 + (K-s)) inside the image
+	auto lowest = [&]( int s ) { return std::max( b0 - ( K-s ), 0 ); };
+	auto highest = [&]( int s ) { return std::min( b1 + ( K-s ), N ); };
+	auto slot = [&]( int s, int r ) { return &ring[s*3 + r % 3][0]; };
+
+	// makes row r of level s from level s-1
+	std::function<void( int, int )> make = [&]( int s, int r )
+	{
+		const pType *up = ( r > 0 ? slot( s-1, r-1 ) : NULL );
+		const pType *down = ( r+1 < N ? slot( s-1, r+1 ) : NULL );
+		pType *out = ( s == K ? img.getRow(r) : slot( s, r ) );
+
+		morphRow( up, slot( s-1, r ), down, out, M, stages[s-1].value, hit );
+		if ( stages[s-1].mapped )
+			maps[s].apply( out, M );
+
+		if ( s == K )
+			return;
+
+		if ( r-1 >= lowest( s+1 ) && r-1 < highest( s+1 ) )
+			make( s+1, r-1 );
+		if ( r == N-1 && r >= lowest( s+1 ) && r < highest( s+1 ) )
+			make( s+1, r );
+	};
+
+	for ( int r = lowest( 0 ); r < highest( 0 ); r++ )
+	{
+		const pType *src;
+		pType *row = slot( 0, r );
+
+		if ( r < b0 )
+			src = &above[(long)( r - lowest( 0 ) ) * M];
+		else if ( r >= b1 )
+			src = &below[(long)( r - b1 ) * M];
+		else
+			src = img.getRow(r);
+
+		std::copy( src, src + M, row );
+		if ( mapped )
+			maps[0].apply( row, M );
+
+		if ( r-1 >= lowest( 1 ) && r-1 < highest( 1 ) )
+			make( 1, r-1 );
+		if ( r == N-1 && r >= lowest( 1 ) && r < highest( 1 ) )
+			make( 1, r );
+	}
+}
+
+/******************************************************************************\
+ a pixel changes to value if any pixel of the 3x3 square around it (inside
+ the image) is value, which is what ImageType::erode and dilate do.  Each
+ column of the three rows is checked once, then every pixel looks at the
+ columns on either side.  hit has a column of padding at each end so the
+ inner loop needs no bounds checks
+\******************************************************************************/
+template <class pType>
+void ImagePipeline<pType>::morphRow( const pType *up, const pType *cur,
+	const pType *down, pType *out, int M, int value, std::vector<char>& hit )
+{
+	char *h = &hit[1];
+
+	hit[0] = hit[M+1] = 0;
+
+	for ( int j = 0; j < M; j++ )
+		h[j] = ( cur[j] == value );
+	if ( up != NULL )
+		for ( int j = 0; j < M; j++ )
+			h[j] |= ( up[j] == value );
+	if ( down != NULL )
+		for ( int j = 0; j < M; j++ )
+			h[j] |= ( down[j] == value );
+
+	for ( int j = 0; j < M; j++ )
+	{
+		if ( h[j-1] | h[j] | h[j+1] )
+			out[j] = value;
+		else
+			out[j] = cur[j];
+	}
+}
+
+#endif
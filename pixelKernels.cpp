@@ -0,0 +1,1056 @@
+#include "pixelKernels.h"
+#include <cstring>
+#include <climits>
+
+// SSE2 is part of every x86-64 processor, AVX2 is only used when the processor
+// running the program reports it
+#if defined(__SSE2__)
+	#include <emmintrin.h>
+	#define KERNEL_SSE2
+#endif
+
+#if defined(__GNUC__) && defined(__x86_64__)
+	#include <immintrin.h>
+	#define KERNEL_AVX2
+	#define AVX2_FUNC __attribute__((target("avx2")))
+#endif
+
+/******************************************************************************\
+                                    SCALAR
+\******************************************************************************/
+
+// clip a value to [0,Q] so it can be stored as a byte
+static unsigned char clip( int val, int Q )
+{
+	if ( val > Q ) val = Q;
+	if ( val < 0 ) val = 0;
+	return (unsigned char)val;
+}
+
+template <class wType>
+static void widenScalar( const unsigned char src[], wType dst[], long n )
+{
+	for ( long i = 0; i < n; i++ )
+		dst[i] = src[i];
+}
+
+template <class wType>
+static void narrowScalar( const wType src[], unsigned char dst[], long n,
+	int Q )
+{
+	for ( long i = 0; i < n; i++ )
+		dst[i] = clip( src[i], Q );
+}
+
+// clip a value to [0,Q] so it can be stored as two bytes
+static unsigned short clip16( int val, int Q )
+{
+	if ( val > Q ) val = Q;
+	if ( val < 0 ) val = 0;
+	return (unsigned short)val;
+}
+
+// the 16 bit versions build each sample out of its bytes, so they work the
+// same way no matter what byte order the processor uses
+template <class wType>
+static void widen16Scalar( const unsigned char src[], wType dst[], long n )
+{
+	for ( long i = 0; i < n; i++ )
+		dst[i] = ( src[2*i] << 8 ) | src[2*i+1];
+}
+
+template <class wType>
+static void narrow16Scalar( const wType src[], unsigned char dst[], long n,
+	int Q )
+{
+	for ( long i = 0; i < n; i++ )
+	{
+		unsigned short val = clip16( src[i], Q );
+		dst[2*i] = val >> 8;
+		dst[2*i+1] = val & 0xFF;
+	}
+}
+
+template <class sType>
+static void splitScalar( const sType src[], sType r[], sType g[], sType b[],
+	long n )
+{
+	for ( long i = 0; i < n; i++ )
+	{
+		r[i] = src[3*i];
+		g[i] = src[3*i+1];
+		b[i] = src[3*i+2];
+	}
+}
+
+template <class sType>
+static void mergeScalar( const sType r[], const sType g[], const sType b[],
+	sType dst[], long n )
+{
+	for ( long i = 0; i < n; i++ )
+	{
+		dst[3*i] = r[i];
+		dst[3*i+1] = g[i];
+		dst[3*i+2] = b[i];
+	}
+}
+
+// the first sample is in channel c
+template <class sType>
+static long lookupScalar( const sType table[], int levels, int channels,
+	int c, const sType src[], sType dst[], long n )
+{
+	for ( long i = 0; i < n; i++ )
+	{
+		int v = src[i];
+
+		if ( v < 0 || v >= levels )
+			return i;
+
+		dst[i] = table[(long)v*channels + c];
+
+		if ( ++c == channels )
+			c = 0;
+	}
+
+	return n;
+}
+
+template <class sType>
+static void reduceScalar( const sType src[], long n, int channels,
+	SampleStats stats[] )
+{
+	int c = 0;
+
+	for ( long i = 0; i < n; i++ )
+	{
+		stats[c].add( src[i] );
+
+		if ( ++c == channels )
+			c = 0;
+	}
+}
+
+static void maxScalar( const unsigned char a[], const unsigned char b[],
+	unsigned char dst[], long n )
+{
+	for ( long i = 0; i < n; i++ )
+		dst[i] = ( a[i] > b[i] ? a[i] : b[i] );
+}
+
+/******************************************************************************\
+                                     AVX2
+ each function handles as many whole vectors as it can and returns how many
+ samples it did, the caller finishes the rest.  The 256 bit packs work inside
+ each 128 bit half, so their results are put back in order with a permute
+\******************************************************************************/
+#ifdef KERNEL_AVX2
+
+// true if the processor running the program has AVX2, only checked once
+static bool haveAVX2()
+{
+	static const bool avx2 = __builtin_cpu_supports( "avx2" );
+	return avx2;
+}
+
+AVX2_FUNC static long widenAVX2( const unsigned char src[], int dst[],
+	long n )
+{
+	long i = 0;
+
+	for ( ; i + 32 <= n; i += 32 )
+		for ( int k = 0; k < 32; k += 8 )
+		{
+			__m128i b = _mm_loadl_epi64( (const __m128i*)(src + i + k) );
+			_mm256_storeu_si256( (__m256i*)(dst + i + k),
+			    _mm256_cvtepu8_epi32( b ) );
+		}
+
+	return i;
+}
+
+AVX2_FUNC static long widenAVX2( const unsigned char src[],
+	unsigned short dst[], long n )
+{
+	long i = 0;
+
+	for ( ; i + 16 <= n; i += 16 )
+	{
+		__m128i b = _mm_loadu_si128( (const __m128i*)(src + i) );
+		_mm256_storeu_si256( (__m256i*)(dst + i), _mm256_cvtepu8_epi16( b ) );
+	}
+
+	return i;
+}
+
+// Q must be in [0,255]
+AVX2_FUNC static long narrowAVX2( const int src[], unsigned char dst[],
+	long n, int Q )
+{
+	const __m256i q = _mm256_set1_epi8( (char)Q );
+	const __m256i order = _mm256_setr_epi32( 0, 4, 1, 5, 2, 6, 3, 7 );
+	long i = 0;
+
+	for ( ; i + 32 <= n; i += 32 )
+	{
+		const __m256i *in = (const __m256i*)(src + i);
+
+		// saturate to 16 then to unsigned 8 bits, anything negative is 0
+		__m256i lo = _mm256_packs_epi32( _mm256_loadu_si256( in ),
+		    _mm256_loadu_si256( in + 1 ) );
+		__m256i hi = _mm256_packs_epi32( _mm256_loadu_si256( in + 2 ),
+		    _mm256_loadu_si256( in + 3 ) );
+		__m256i b = _mm256_packus_epi16( lo, hi );
+
+		b = _mm256_permutevar8x32_epi32( b, order );
+		_mm256_storeu_si256( (__m256i*)(dst + i), _mm256_min_epu8( b, q ) );
+	}
+
+	return i;
+}
+
+// Q must be in [0,255]
+AVX2_FUNC static long narrowAVX2( const unsigned short src[],
+	unsigned char dst[], long n, int Q )
+{
+	const __m256i q = _mm256_set1_epi16( (short)Q );
+	long i = 0;
+
+	for ( ; i + 32 <= n; i += 32 )
+	{
+		const __m256i *in = (const __m256i*)(src + i);
+		__m256i a = _mm256_loadu_si256( in );
+		__m256i c = _mm256_loadu_si256( in + 1 );
+
+		// a - max(a-Q,0) is min(a,Q), which always fits in a byte
+		a = _mm256_sub_epi16( a, _mm256_subs_epu16( a, q ) );
+		c = _mm256_sub_epi16( c, _mm256_subs_epu16( c, q ) );
+
+		__m256i b = _mm256_permute4x64_epi64( _mm256_packus_epi16( a, c ),
+		    0xD8 );
+		_mm256_storeu_si256( (__m256i*)(dst + i), b );
+	}
+
+	return i;
+}
+
+// Q must be in [0,255]
+AVX2_FUNC static long narrowAVX2( const unsigned char src[],
+	unsigned char dst[], long n, int Q )
+{
+	const __m256i q = _mm256_set1_epi8( (char)Q );
+	long i = 0;
+
+	for ( ; i + 32 <= n; i += 32 )
+	{
+		__m256i b = _mm256_loadu_si256( (const __m256i*)(src + i) );
+		_mm256_storeu_si256( (__m256i*)(dst + i), _mm256_min_epu8( b, q ) );
+	}
+
+	return i;
+}
+
+// swaps the two bytes of every 16 bit sample
+AVX2_FUNC static inline __m256i swap16AVX2( __m256i v )
+{
+	return _mm256_or_si256( _mm256_slli_epi16( v, 8 ),
+	    _mm256_srli_epi16( v, 8 ) );
+}
+
+AVX2_FUNC static long widen16AVX2( const unsigned char src[], int dst[],
+	long n )
+{
+	long i = 0;
+
+	for ( ; i + 16 <= n; i += 16 )
+	{
+		__m256i v = swap16AVX2(
+		    _mm256_loadu_si256( (const __m256i*)(src + 2*i) ) );
+		__m256i *out = (__m256i*)(dst + i);
+
+		_mm256_storeu_si256( out,
+		    _mm256_cvtepu16_epi32( _mm256_castsi256_si128( v ) ) );
+		_mm256_storeu_si256( out + 1,
+		    _mm256_cvtepu16_epi32( _mm256_extracti128_si256( v, 1 ) ) );
+	}
+
+	return i;
+}
+
+AVX2_FUNC static long widen16AVX2( const unsigned char src[],
+	unsigned short dst[], long n )
+{
+	long i = 0;
+
+	for ( ; i + 16 <= n; i += 16 )
+	{
+		__m256i v = _mm256_loadu_si256( (const __m256i*)(src + 2*i) );
+		_mm256_storeu_si256( (__m256i*)(dst + i), swap16AVX2( v ) );
+	}
+
+	return i;
+}
+
+// Q must be in [0,65535]
+AVX2_FUNC static long narrow16AVX2( const int src[], unsigned char dst[],
+	long n, int Q )
+{
+	const __m256i q = _mm256_set1_epi32( Q );
+	const __m256i zero = _mm256_setzero_si256();
+	long i = 0;
+
+	for ( ; i + 16 <= n; i += 16 )
+	{
+		const __m256i *in = (const __m256i*)(src + i);
+		__m256i a = _mm256_loadu_si256( in );
+		__m256i c = _mm256_loadu_si256( in + 1 );
+
+		a = _mm256_min_epi32( _mm256_max_epi32( a, zero ), q );
+		c = _mm256_min_epi32( _mm256_max_epi32( c, zero ), q );
+
+		__m256i v = _mm256_permute4x64_epi64( _mm256_packus_epi32( a, c ),
+		    0xD8 );
+		_mm256_storeu_si256( (__m256i*)(dst + 2*i), swap16AVX2( v ) );
+	}
+
+	return i;
+}
+
+// Q must be in [0,65535]
+AVX2_FUNC static long narrow16AVX2( const unsigned short src[],
+	unsigned char dst[], long n, int Q )
+{
+	const __m256i q = _mm256_set1_epi16( (short)Q );
+	long i = 0;
+
+	for ( ; i + 16 <= n; i += 16 )
+	{
+		__m256i a = _mm256_loadu_si256( (const __m256i*)(src + i) );
+		a = _mm256_min_epu16( a, q );
+		_mm256_storeu_si256( (__m256i*)(dst + 2*i), swap16AVX2( a ) );
+	}
+
+	return i;
+}
+
+/******************************************************************************\
+ eight samples are looked up with one gather once they're all known to be in
+ the table.  With three channels the channel of each lane cycles, a vector
+ starting at sample i starts at channel i % 3
+\******************************************************************************/
+AVX2_FUNC static long lookupAVX2( const int table[], int levels,
+	int channels, const int src[], int dst[], long n )
+{
+	const __m256i low = _mm256_set1_epi32( -1 );
+	const __m256i high = _mm256_set1_epi32( levels );
+	const __m256i width = _mm256_set1_epi32( channels );
+	__m256i phase[3];
+	long i = 0;
+
+	if ( channels == 1 )
+		phase[0] = _mm256_setzero_si256();
+	else if ( channels == 3 )
+	{
+		phase[0] = _mm256_setr_epi32( 0, 1, 2, 0, 1, 2, 0, 1 );
+		phase[1] = _mm256_setr_epi32( 1, 2, 0, 1, 2, 0, 1, 2 );
+		phase[2] = _mm256_setr_epi32( 2, 0, 1, 2, 0, 1, 2, 0 );
+	}
+	else
+		return 0;
+
+	for ( ; i + 8 <= n; i += 8 )
+	{
+		__m256i v = _mm256_loadu_si256( (const __m256i*)(src + i) );
+		__m256i inside = _mm256_and_si256( _mm256_cmpgt_epi32( v, low ),
+		    _mm256_cmpgt_epi32( high, v ) );
+
+		if ( _mm256_movemask_epi8( inside ) != -1 )
+			break;
+
+		__m256i index = _mm256_add_epi32( _mm256_mullo_epi32( v, width ),
+		    phase[channels == 1 ? 0 : i % 3] );
+		_mm256_storeu_si256( (__m256i*)(dst + i),
+		    _mm256_i32gather_epi32( table, index, 4 ) );
+	}
+
+	return i;
+}
+
+// eight samples widened to 32 bits
+AVX2_FUNC static inline __m256i load8AVX2( const int src[] )
+{
+	return _mm256_loadu_si256( (const __m256i*)src );
+}
+
+AVX2_FUNC static inline __m256i load8AVX2( const unsigned short src[] )
+{
+	return _mm256_cvtepu16_epi32( _mm_loadu_si128( (const __m128i*)src ) );
+}
+
+AVX2_FUNC static inline __m256i load8AVX2( const unsigned char src[] )
+{
+	return _mm256_cvtepu8_epi32( _mm_loadl_epi64( (const __m128i*)src ) );
+}
+
+/******************************************************************************\
+ a step takes one vector per channel, so lane k of accumulator a always
+ holds samples of channel ( 8a + k ) % channels.  Sums are widened to 64 bit
+ lanes and squares to doubles as they're added, the lanes are only added
+ into the channels at the end
+\******************************************************************************/
+template <class sType>
+AVX2_FUNC static long reduceAVX2( const sType src[], long n, int channels,
+	SampleStats stats[] )
+{
+	__m256i sum[3][2], low[3], high[3];
+	__m256d squares[3][2];
+	const long step = 8 * channels;
+	long i = 0;
+
+	if ( channels != 1 && channels != 3 )
+		return 0;
+
+	for ( int a = 0; a < channels; a++ )
+	{
+		sum[a][0] = sum[a][1] = _mm256_setzero_si256();
+		squares[a][0] = squares[a][1] = _mm256_setzero_pd();
+		low[a] = _mm256_set1_epi32( INT_MAX );
+		high[a] = _mm256_set1_epi32( INT_MIN );
+	}
+
+	for ( ; i + step <= n; i += step )
+		for ( int a = 0; a < channels; a++ )
+		{
+			__m256i v = load8AVX2( src + i + 8*a );
+			__m128i lo = _mm256_castsi256_si128( v );
+			__m128i hi = _mm256_extracti128_si256( v, 1 );
+			__m256d dlo = _mm256_cvtepi32_pd( lo );
+			__m256d dhi = _mm256_cvtepi32_pd( hi );
+
+			sum[a][0] = _mm256_add_epi64( sum[a][0],
+			    _mm256_cvtepi32_epi64( lo ) );
+			sum[a][1] = _mm256_add_epi64( sum[a][1],
+			    _mm256_cvtepi32_epi64( hi ) );
+			squares[a][0] = _mm256_add_pd( squares[a][0],
+			    _mm256_mul_pd( dlo, dlo ) );
+			squares[a][1] = _mm256_add_pd( squares[a][1],
+			    _mm256_mul_pd( dhi, dhi ) );
+			low[a] = _mm256_min_epi32( low[a], v );
+			high[a] = _mm256_max_epi32( high[a], v );
+		}
+
+	if ( i == 0 )
+		return 0;
+
+	for ( int a = 0; a < channels; a++ )
+	{
+		long long s[8];
+		double q[8];
+		int l[8], h[8];
+
+		_mm256_storeu_si256( (__m256i*)s, sum[a][0] );
+		_mm256_storeu_si256( (__m256i*)(s + 4), sum[a][1] );
+		_mm256_storeu_pd( q, squares[a][0] );
+		_mm256_storeu_pd( q + 4, squares[a][1] );
+		_mm256_storeu_si256( (__m256i*)l, low[a] );
+		_mm256_storeu_si256( (__m256i*)h, high[a] );
+
+		for ( int k = 0; k < 8; k++ )
+		{
+			SampleStats &st = stats[( 8*a + k ) % channels];
+
+			st.sum += s[k];
+			st.squares += q[k];
+			if ( l[k] < st.min ) st.min = l[k];
+			if ( h[k] > st.max ) st.max = h[k];
+		}
+	}
+
+	for ( int c = 0; c < channels; c++ )
+		stats[c].count += i / channels;
+
+	return i;
+}
+
+AVX2_FUNC static long maxAVX2( const unsigned char a[],
+	const unsigned char b[], unsigned char dst[], long n )
+{
+	long i = 0;
+
+	for ( ; i + 32 <= n; i += 32 )
+	{
+		__m256i x = _mm256_loadu_si256( (const __m256i*)(a + i) );
+		__m256i y = _mm256_loadu_si256( (const __m256i*)(b + i) );
+		_mm256_storeu_si256( (__m256i*)(dst + i), _mm256_max_epu8( x, y ) );
+	}
+
+	return i;
+}
+
+#endif
+
+/******************************************************************************\
+                                     SSE2
+\******************************************************************************/
+#ifdef KERNEL_SSE2
+
+static long widenSSE2( const unsigned char src[], int dst[], long n )
+{
+	const __m128i zero = _mm_setzero_si128();
+	long i = 0;
+
+	for ( ; i + 16 <= n; i += 16 )
+	{
+		__m128i b = _mm_loadu_si128( (const __m128i*)(src + i) );
+		__m128i lo = _mm_unpacklo_epi8( b, zero );
+		__m128i hi = _mm_unpackhi_epi8( b, zero );
+		__m128i *out = (__m128i*)(dst + i);
+
+		_mm_storeu_si128( out,     _mm_unpacklo_epi16( lo, zero ) );
+		_mm_storeu_si128( out + 1, _mm_unpackhi_epi16( lo, zero ) );
+		_mm_storeu_si128( out + 2, _mm_unpacklo_epi16( hi, zero ) );
+		_mm_storeu_si128( out + 3, _mm_unpackhi_epi16( hi, zero ) );
+	}
+
+	return i;
+}
+
+static long widenSSE2( const unsigned char src[], unsigned short dst[],
+	long n )
+{
+	const __m128i zero = _mm_setzero_si128();
+	long i = 0;
+
+	for ( ; i + 16 <= n; i += 16 )
+	{
+		__m128i b = _mm_loadu_si128( (const __m128i*)(src + i) );
+		__m128i *out = (__m128i*)(dst + i);
+
+		_mm_storeu_si128( out,     _mm_unpacklo_epi8( b, zero ) );
+		_mm_storeu_si128( out + 1, _mm_unpackhi_epi8( b, zero ) );
+	}
+
+	return i;
+}
+
+// Q must be in [0,255]
+static long narrowSSE2( const int src[], unsigned char dst[], long n, int Q )
+{
+	const __m128i q = _mm_set1_epi8( (char)Q );
+	long i = 0;
+
+	for ( ; i + 16 <= n; i += 16 )
+	{
+		const __m128i *in = (const __m128i*)(src + i);
+
+		// saturate to 16 then to unsigned 8 bits, anything negative is 0
+		__m128i lo = _mm_packs_epi32( _mm_loadu_si128( in ),
+		    _mm_loadu_si128( in + 1 ) );
+		__m128i hi = _mm_packs_epi32( _mm_loadu_si128( in + 2 ),
+		    _mm_loadu_si128( in + 3 ) );
+		__m128i b = _mm_packus_epi16( lo, hi );
+
+		_mm_storeu_si128( (__m128i*)(dst + i), _mm_min_epu8( b, q ) );
+	}
+
+	return i;
+}
+
+// Q must be in [0,255]
+static long narrowSSE2( const unsigned short src[], unsigned char dst[],
+	long n, int Q )
+{
+	const __m128i q = _mm_set1_epi16( (short)Q );
+	long i = 0;
+
+	for ( ; i + 16 <= n; i += 16 )
+	{
+		const __m128i *in = (const __m128i*)(src + i);
+		__m128i a = _mm_loadu_si128( in );
+		__m128i c = _mm_loadu_si128( in + 1 );
+
+		// a - max(a-Q,0) is min(a,Q), which always fits in a byte
+		a = _mm_sub_epi16( a, _mm_subs_epu16( a, q ) );
+		c = _mm_sub_epi16( c, _mm_subs_epu16( c, q ) );
+
+		_mm_storeu_si128( (__m128i*)(dst + i), _mm_packus_epi16( a, c ) );
+	}
+
+	return i;
+}
+
+// Q must be in [0,255]
+static long narrowSSE2( const unsigned char src[], unsigned char dst[],
+	long n, int Q )
+{
+	const __m128i q = _mm_set1_epi8( (char)Q );
+	long i = 0;
+
+	for ( ; i + 16 <= n; i += 16 )
+	{
+		__m128i b = _mm_loadu_si128( (const __m128i*)(src + i) );
+		_mm_storeu_si128( (__m128i*)(dst + i), _mm_min_epu8( b, q ) );
+	}
+
+	return i;
+}
+
+// swaps the two bytes of every 16 bit sample
+static inline __m128i swap16SSE2( __m128i v )
+{
+	return _mm_or_si128( _mm_slli_epi16( v, 8 ), _mm_srli_epi16( v, 8 ) );
+}
+
+static long widen16SSE2( const unsigned char src[], int dst[], long n )
+{
+	const __m128i zero = _mm_setzero_si128();
+	long i = 0;
+
+	for ( ; i + 8 <= n; i += 8 )
+	{
+		__m128i v = swap16SSE2(
+		    _mm_loadu_si128( (const __m128i*)(src + 2*i) ) );
+		__m128i *out = (__m128i*)(dst + i);
+
+		_mm_storeu_si128( out,     _mm_unpacklo_epi16( v, zero ) );
+		_mm_storeu_si128( out + 1, _mm_unpackhi_epi16( v, zero ) );
+	}
+
+	return i;
+}
+
+static long widen16SSE2( const unsigned char src[], unsigned short dst[],
+	long n )
+{
+	long i = 0;
+
+	for ( ; i + 8 <= n; i += 8 )
+	{
+		__m128i v = _mm_loadu_si128( (const __m128i*)(src + 2*i) );
+		_mm_storeu_si128( (__m128i*)(dst + i), swap16SSE2( v ) );
+	}
+
+	return i;
+}
+
+// clips four ints to [0,Q], SSE2 has no 32 bit min or max so the clipping is
+// done with compares
+static inline __m128i clip32SSE2( __m128i v, __m128i q )
+{
+	v = _mm_and_si128( v, _mm_cmpgt_epi32( v, _mm_set1_epi32( -1 ) ) );
+
+	__m128i over = _mm_cmpgt_epi32( v, q );
+	return _mm_or_si128( _mm_and_si128( over, q ),
+	    _mm_andnot_si128( over, v ) );
+}
+
+// Q must be in [0,65535]
+static long narrow16SSE2( const int src[], unsigned char dst[], long n,
+	int Q )
+{
+	const __m128i q = _mm_set1_epi32( Q );
+	const __m128i bias32 = _mm_set1_epi32( 32768 );
+	const __m128i bias16 = _mm_set1_epi16( (short)0x8000 );
+	long i = 0;
+
+	for ( ; i + 8 <= n; i += 8 )
+	{
+		const __m128i *in = (const __m128i*)(src + i);
+		__m128i a = clip32SSE2( _mm_loadu_si128( in ), q );
+		__m128i c = clip32SSE2( _mm_loadu_si128( in + 1 ), q );
+
+		// SSE2 only packs to signed 16 bits, so shift the range down first
+		// and flip the top bit back afterwards
+		__m128i v = _mm_packs_epi32( _mm_sub_epi32( a, bias32 ),
+		    _mm_sub_epi32( c, bias32 ) );
+		v = _mm_xor_si128( v, bias16 );
+
+		_mm_storeu_si128( (__m128i*)(dst + 2*i), swap16SSE2( v ) );
+	}
+
+	return i;
+}
+
+// Q must be in [0,65535]
+static long narrow16SSE2( const unsigned short src[], unsigned char dst[],
+	long n, int Q )
+{
+	const __m128i q = _mm_set1_epi16( (short)Q );
+	long i = 0;
+
+	for ( ; i + 8 <= n; i += 8 )
+	{
+		__m128i a = _mm_loadu_si128( (const __m128i*)(src + i) );
+
+		// a - max(a-Q,0) is min(a,Q)
+		a = _mm_sub_epi16( a, _mm_subs_epu16( a, q ) );
+		_mm_storeu_si128( (__m128i*)(dst + 2*i), swap16SSE2( a ) );
+	}
+
+	return i;
+}
+
+/******************************************************************************\
+ four interleaved pixels are three vectors
+   x = r0 g0 b0 r1,  y = g1 b1 r2 g2,  z = b2 r3 g3 b3
+ each channel is gathered two samples at a time into the even lanes of two
+ vectors, and the even lanes are then put together.  The float shuffles only
+ move bits so they're safe on ints
+\******************************************************************************/
+
+// the even lanes of a followed by the even lanes of b
+static inline __m128 evensSSE2( __m128 a, __m128 b )
+{
+	return _mm_shuffle_ps( a, b, _MM_SHUFFLE( 2, 0, 2, 0 ) );
+}
+
+static long splitSSE2( const int src[], int r[], int g[], int b[], long n )
+{
+	long i = 0;
+
+	for ( ; i + 4 <= n; i += 4 )
+	{
+		const float *in = (const float*)(src + 3*i);
+		__m128 x = _mm_loadu_ps( in );
+		__m128 y = _mm_loadu_ps( in + 4 );
+		__m128 z = _mm_loadu_ps( in + 8 );
+
+		__m128 red = evensSSE2(
+		    _mm_shuffle_ps( x, x, _MM_SHUFFLE( 3,3,0,0 ) ),
+		    _mm_shuffle_ps( y, z, _MM_SHUFFLE( 1,1,2,2 ) ) );
+		__m128 green = evensSSE2(
+		    _mm_shuffle_ps( x, y, _MM_SHUFFLE( 0,0,1,1 ) ),
+		    _mm_shuffle_ps( y, z, _MM_SHUFFLE( 2,2,3,3 ) ) );
+		__m128 blue = evensSSE2(
+		    _mm_shuffle_ps( x, y, _MM_SHUFFLE( 1,1,2,2 ) ),
+		    _mm_shuffle_ps( z, z, _MM_SHUFFLE( 3,3,0,0 ) ) );
+
+		_mm_storeu_ps( (float*)(r + i), red );
+		_mm_storeu_ps( (float*)(g + i), green );
+		_mm_storeu_ps( (float*)(b + i), blue );
+	}
+
+	return i;
+}
+
+static long mergeSSE2( const int r[], const int g[], const int b[], int dst[],
+	long n )
+{
+	long i = 0;
+
+	for ( ; i + 4 <= n; i += 4 )
+	{
+		__m128 red = _mm_loadu_ps( (const float*)(r + i) );
+		__m128 green = _mm_loadu_ps( (const float*)(g + i) );
+		__m128 blue = _mm_loadu_ps( (const float*)(b + i) );
+		float *out = (float*)(dst + 3*i);
+
+		// r0 g0 | b0 r1,  g1 b1 | r2 g2,  b2 r3 | g3 b3
+		_mm_storeu_ps( out, _mm_shuffle_ps( _mm_unpacklo_ps( red, green ),
+		    _mm_shuffle_ps( blue, red, _MM_SHUFFLE( 1,1,0,0 ) ),
+		    _MM_SHUFFLE( 2,0,1,0 ) ) );
+		_mm_storeu_ps( out + 4, evensSSE2(
+		    _mm_shuffle_ps( green, blue, _MM_SHUFFLE( 1,1,1,1 ) ),
+		    _mm_shuffle_ps( red, green, _MM_SHUFFLE( 2,2,2,2 ) ) ) );
+		_mm_storeu_ps( out + 8, evensSSE2(
+		    _mm_shuffle_ps( blue, red, _MM_SHUFFLE( 3,3,2,2 ) ),
+		    _mm_shuffle_ps( green, blue, _MM_SHUFFLE( 3,3,3,3 ) ) ) );
+	}
+
+	return i;
+}
+
+static long maxSSE2( const unsigned char a[], const unsigned char b[],
+	unsigned char dst[], long n )
+{
+	long i = 0;
+
+	for ( ; i + 16 <= n; i += 16 )
+	{
+		__m128i x = _mm_loadu_si128( (const __m128i*)(a + i) );
+		__m128i y = _mm_loadu_si128( (const __m128i*)(b + i) );
+		_mm_storeu_si128( (__m128i*)(dst + i), _mm_max_epu8( x, y ) );
+	}
+
+	return i;
+}
+
+#endif
+
+/******************************************************************************\
+ picks the widest kernel the processor has and finishes the leftover samples
+ with the plain loop
+\******************************************************************************/
+template <class wType>
+static void widen( const unsigned char src[], wType dst[], long n )
+{
+	long done = 0;
+
+#if defined(KERNEL_AVX2)
+	if ( haveAVX2() )
+		done = widenAVX2( src, dst, n );
+	else
+#endif
+#if defined(KERNEL_SSE2)
+		done = widenSSE2( src, dst, n );
+#endif
+
+	widenScalar( src + done, dst + done, n - done );
+}
+
+// the vector kernels only know how to clip to a Q that fits in a byte
+template <class wType>
+static void narrow( const wType src[], unsigned char dst[], long n, int Q )
+{
+	long done = 0;
+
+	if ( Q >= 0 && Q <= 255 )
+	{
+#if defined(KERNEL_AVX2)
+		if ( haveAVX2() )
+			done = narrowAVX2( src, dst, n, Q );
+		else
+#endif
+#if defined(KERNEL_SSE2)
+			done = narrowSSE2( src, dst, n, Q );
+#endif
+	}
+
+	narrowScalar( src + done, dst + done, n - done, Q );
+}
+
+void widenSamples( const unsigned char src[], int dst[], long n )
+{
+	widen( src, dst, n );
+}
+
+void widenSamples( const unsigned char src[], unsigned short dst[], long n )
+{
+	widen( src, dst, n );
+}
+
+void widenSamples( const unsigned char src[], unsigned char dst[], long n )
+{
+	memcpy( dst, src, n );
+}
+
+void narrowSamples( const int src[], unsigned char dst[], long n, int Q )
+{
+	narrow( src, dst, n, Q );
+}
+
+void narrowSamples( const unsigned short src[], unsigned char dst[], long n,
+	int Q )
+{
+	narrow( src, dst, n, Q );
+}
+
+// a byte can never be above 255, so only a smaller Q needs any clipping
+void narrowSamples( const unsigned char src[], unsigned char dst[], long n,
+	int Q )
+{
+	if ( Q >= 255 )
+		memcpy( dst, src, n );
+	else
+		narrow( src, dst, n, Q );
+}
+
+/******************************************************************************\
+ the 16 bit versions pick their kernel the same way, the byte swapping
+ kernels are only built for little-endian processors
+\******************************************************************************/
+template <class wType>
+static void widen16( const unsigned char src[], wType dst[], long n )
+{
+	long done = 0;
+
+#if defined(KERNEL_AVX2)
+	if ( haveAVX2() )
+		done = widen16AVX2( src, dst, n );
+	else
+#endif
+#if defined(KERNEL_SSE2)
+		done = widen16SSE2( src, dst, n );
+#endif
+
+	widen16Scalar( src + 2*done, dst + done, n - done );
+}
+
+template <class wType>
+static void narrow16( const wType src[], unsigned char dst[], long n, int Q )
+{
+	long done = 0;
+
+	if ( Q >= 0 && Q <= 65535 )
+	{
+#if defined(KERNEL_AVX2)
+		if ( haveAVX2() )
+			done = narrow16AVX2( src, dst, n, Q );
+		else
+#endif
+#if defined(KERNEL_SSE2)
+			done = narrow16SSE2( src, dst, n, Q );
+#endif
+	}
+
+	narrow16Scalar( src + done, dst + 2*done, n - done, Q );
+}
+
+void widenSamples16( const unsigned char src[], int dst[], long n )
+{
+	widen16( src, dst, n );
+}
+
+void widenSamples16( const unsigned char src[], unsigned short dst[], long n )
+{
+	widen16( src, dst, n );
+}
+
+void widenSamples16( const unsigned char src[], unsigned char dst[], long n )
+{
+	for ( long i = 0; i < n; i++ )
+		dst[i] = ( src[2*i] != 0 ? 255 : src[2*i+1] );
+}
+
+void narrowSamples16( const int src[], unsigned char dst[], long n, int Q )
+{
+	narrow16( src, dst, n, Q );
+}
+
+void narrowSamples16( const unsigned short src[], unsigned char dst[], long n,
+	int Q )
+{
+	narrow16( src, dst, n, Q );
+}
+
+// 8 bit images with a Q above 255 are rare, the plain loop is enough
+void narrowSamples16( const unsigned char src[], unsigned char dst[], long n,
+	int Q )
+{
+	narrow16Scalar( src, dst, n, Q );
+}
+
+/******************************************************************************\
+ only the int versions have a vector kernel, bytes are moved with the plain
+ loops
+\******************************************************************************/
+void splitChannels( const int src[], int r[], int g[], int b[], long n )
+{
+	long done = 0;
+
+#if defined(KERNEL_SSE2)
+	done = splitSSE2( src, r, g, b, n );
+#endif
+
+	splitScalar( src + 3*done, r + done, g + done, b + done, n - done );
+}
+
+void splitChannels( const unsigned char src[], unsigned char r[],
+	unsigned char g[], unsigned char b[], long n )
+{
+	splitScalar( src, r, g, b, n );
+}
+
+void mergeChannels( const int r[], const int g[], const int b[], int dst[],
+	long n )
+{
+	long done = 0;
+
+#if defined(KERNEL_SSE2)
+	done = mergeSSE2( r, g, b, dst, n );
+#endif
+
+	mergeScalar( r + done, g + done, b + done, dst + 3*done, n - done );
+}
+
+void mergeChannels( const unsigned char r[], const unsigned char g[],
+	const unsigned char b[], unsigned char dst[], long n )
+{
+	mergeScalar( r, g, b, dst, n );
+}
+
+/******************************************************************************\
+ only int tables have a vector kernel (a gather), the smaller types are
+ looked up with the plain loop.  Whatever the vector kernel leaves, whether
+ the end of the run or a sample off the table, the plain loop picks up from
+ the sample it stopped on
+\******************************************************************************/
+long lookupSamples( const int table[], int levels, int channels,
+	const int src[], int dst[], long n )
+{
+	long done = 0;
+
+#if defined(KERNEL_AVX2)
+	if ( haveAVX2() && (long)levels * channels <= 0x7FFFFFFF )
+		done = lookupAVX2( table, levels, channels, src, dst, n );
+#endif
+
+	return done + lookupScalar( table, levels, channels, done % channels,
+	    src + done, dst + done, n - done );
+}
+
+long lookupSamples( const unsigned short table[], int levels, int channels,
+	const unsigned short src[], unsigned short dst[], long n )
+{
+	return lookupScalar( table, levels, channels, 0, src, dst, n );
+}
+
+long lookupSamples( const unsigned char table[], int levels, int channels,
+	const unsigned char src[], unsigned char dst[], long n )
+{
+	return lookupScalar( table, levels, channels, 0, src, dst, n );
+}
+
+/******************************************************************************\
+ only AVX2 has a vector kernel (SSE2 has no 32 bit min and max or widening
+ to 64 bits), it always stops on a whole pixel so the plain loop finishes
+ from channel 0
+\******************************************************************************/
+template <class sType>
+static void reduce( const sType src[], long n, int channels,
+	SampleStats stats[] )
+{
+	long done = 0;
+
+#if defined(KERNEL_AVX2)
+	if ( haveAVX2() )
+		done = reduceAVX2( src, n, channels, stats );
+#endif
+
+	reduceScalar( src + done, n - done, channels, stats );
+}
+
+void reduceSamples( const int src[], long n, int channels,
+	SampleStats stats[] )
+{
+	reduce( src, n, channels, stats );
+}
+
+void reduceSamples( const unsigned short src[], long n, int channels,
+	SampleStats stats[] )
+{
+	reduce( src, n, channels, stats );
+}
+
+void reduceSamples( const unsigned char src[], long n, int channels,
+	SampleStats stats[] )
+{
+	reduce( src, n, channels, stats );
+}
+
+void maxSamples( const unsigned char a[], const unsigned char b[],
+	unsigned char dst[], long n )
+{
+	long done = 0;
+
+#if defined(KERNEL_AVX2)
+	if ( haveAVX2() )
+		done = maxAVX2( a, b, dst, n );
+	else
+#endif
+#if defined(KERNEL_SSE2)
+		done = maxSSE2( a, b, dst, n );
+#endif
+
+	maxScalar( a + done, b + done, dst + done, n - done );
+}
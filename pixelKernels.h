@@ -0,0 +1,98 @@
+/******************************************************************************\
+ Kernels that move samples between the bytes of a PGM/PPM file and the pixels
+ of an ImageType.  They work on plain runs of samples, a color row is simply
+ three times as many samples because rgb and rgb8 store their channels in the
+ same r,g,b order the file does (so no interleaving is ever needed).
+ splitChannels and mergeChannels move color pixels to and from separate
+ planes for PlanarImage, lookupSamples runs samples through the tables of a
+ PointMap and reduceSamples adds samples up into a SampleStats per channel.
+ maxSamples is the running max of the erode and dilate masks.
+
+ Files with Q above 255 store every sample as two bytes, most significant
+ byte first.  The 16 bit kernels swap those bytes into (or out of) the order
+ the processor uses while they convert.
+
+ Where the processor has them SSE2 or AVX2 versions are used (picked once at
+ run time), everything else falls back to the plain loops.  All versions give
+ exactly the same results.
+\******************************************************************************/
+
+#ifndef PIXEL_KERNELS
+#define PIXEL_KERNELS
+
+#include "sampleStats.h"
+
+// name : widenSamples
+// input : n bytes from a file and an array of n samples
+// output : copies each byte into the wider sample type
+void widenSamples( const unsigned char[], int[], long );
+void widenSamples( const unsigned char[], unsigned short[], long );
+void widenSamples( const unsigned char[], unsigned char[], long );
+
+// name : narrowSamples
+// input : n samples, an array of n bytes and the maximum value Q
+// output : clips each sample to [0,Q] and stores it as a byte
+void narrowSamples( const int[], unsigned char[], long, int );
+void narrowSamples( const unsigned short[], unsigned char[], long, int );
+void narrowSamples( const unsigned char[], unsigned char[], long, int );
+
+// name : widenSamples16
+// input : 2n bytes holding n big-endian samples and an array of n samples
+// output : stores each sample in the host's byte order, the 8 bit version
+//          saturates to 255 (an 8 bit image can't hold more)
+void widenSamples16( const unsigned char[], int[], long );
+void widenSamples16( const unsigned char[], unsigned short[], long );
+void widenSamples16( const unsigned char[], unsigned char[], long );
+
+// name : narrowSamples16
+// input : n samples, an array of 2n bytes and the maximum value Q
+// output : clips each sample to [0,Q] and stores it as a big-endian pair of
+//          bytes
+void narrowSamples16( const int[], unsigned char[], long, int );
+void narrowSamples16( const unsigned short[], unsigned char[], long, int );
+void narrowSamples16( const unsigned char[], unsigned char[], long, int );
+
+// name : splitChannels
+// input : n pixels of three interleaved channels (r,g,b order) and three
+//         arrays of n samples
+// output : copies each channel into its own array
+void splitChannels( const int[], int[], int[], int[], long );
+void splitChannels( const unsigned char[], unsigned char[], unsigned char[],
+    unsigned char[], long );
+
+// name : mergeChannels
+// input : three arrays of n samples and an array of n interleaved pixels
+// output : interleaves the channels back into r,g,b pixels
+void mergeChannels( const int[], const int[], const int[], int[], long );
+void mergeChannels( const unsigned char[], const unsigned char[],
+    const unsigned char[], unsigned char[], long );
+
+// name : lookupSamples
+// input : a table of levels rows of one value per channel, levels, the
+//         number of channels, n samples (channel i % channels for sample i)
+//         and an array of n samples
+// output : sets each sample to its table entry.  Stops at the first sample
+//          outside [0,levels) and returns how many it did, n if every
+//          sample was in the table
+long lookupSamples( const int[], int, int, const int[], int[], long );
+long lookupSamples( const unsigned short[], int, int, const unsigned short[],
+    unsigned short[], long );
+long lookupSamples( const unsigned char[], int, int, const unsigned char[],
+    unsigned char[], long );
+
+// name : reduceSamples
+// input : n samples, the number of channels (1 or 3, channel i % channels
+//         for sample i) and a SampleStats per channel
+// output : adds each sample to the stats of its channel
+void reduceSamples( const int[], long, int, SampleStats[] );
+void reduceSamples( const unsigned short[], long, int, SampleStats[] );
+void reduceSamples( const unsigned char[], long, int, SampleStats[] );
+
+// name : maxSamples
+// input : two arrays of n bytes and an array of n bytes
+// output : sets each byte to the larger of the pair, the output may be
+//          either input
+void maxSamples( const unsigned char[], const unsigned char[],
+    unsigned char[], long );
+
+#endif
@@ -0,0 +1,106 @@
+/******************************************************************************\
+ pixelTraits describes the types that can be used as pixels in an ImageType.
+ The compact types (unsigned char, unsigned short and rgb8) can't hold
+ intermediate values like sums or differences of pixels, so every pixel type
+ has a "wide" type that calculations are done in.  A value is converted to
+ the wide type with widen and back to a pixel with narrow, narrow saturates
+ to the range of the pixel type instead of wrapping around.
+
+ maxLevel is the largest value one channel of the pixel can hold, so it is
+ also the largest Q an image of that type can be read with.  channel is the
+ type of one channel on its own, the pixel type of a plane in PlanarImage.
+
+ int and rgb are their own wide type and their conversions do nothing, so
+ images of those types behave exactly as they always have.
+
+   pixel type        wide type   channel type     levels
+   int               int         int              any
+   unsigned char     int         unsigned char    0 - 255
+   unsigned short    int         unsigned short   0 - 65535
+   rgb               rgb         int              any
+   rgb8              rgb         unsigned char    0 - 255 per channel
+\******************************************************************************/
+
+#ifndef PIXEL_TRAITS
+#define PIXEL_TRAITS
+
+#include <climits>
+#include "rgb.h"
+
+// int and rgb, calculations are done in the pixel type itself
+template <class pType>
+struct pixelTraits
+{
+	typedef pType wide;
+	typedef pType channel;
+
+	// true if the pixel is three channels
+	static const bool color = false;
+	static const int maxLevel = INT_MAX;
+
+	static wide widen( const pType& val ) { return val; }
+	static pType narrow( const wide& val ) { return val; }
+};
+
+template <>
+struct pixelTraits<rgb>
+{
+	typedef rgb wide;
+	typedef int channel;
+
+	static const bool color = true;
+	static const int maxLevel = INT_MAX;
+
+	static wide widen( const rgb& val ) { return val; }
+	static rgb narrow( const wide& val ) { return val; }
+};
+
+// 8 bit grayscale
+template <>
+struct pixelTraits<unsigned char>
+{
+	typedef int wide;
+	typedef unsigned char channel;
+
+	static const bool color = false;
+	static const int maxLevel = 255;
+
+	static wide widen( const unsigned char& val ) { return val; }
+	static unsigned char narrow( const wide& val )
+	{
+		return ( val < 0 ? 0 : ( val > 255 ? 255 : val ) );
+	}
+};
+
+// 16 bit grayscale
+template <>
+struct pixelTraits<unsigned short>
+{
+	typedef int wide;
+	typedef unsigned short channel;
+
+	static const bool color = false;
+	static const int maxLevel = 65535;
+
+	static wide widen( const unsigned short& val ) { return val; }
+	static unsigned short narrow( const wide& val )
+	{
+		return ( val < 0 ? 0 : ( val > 65535 ? 65535 : val ) );
+	}
+};
+
+// packed 8 bit color
+template <>
+struct pixelTraits<rgb8>
+{
+	typedef rgb wide;
+	typedef unsigned char channel;
+
+	static const bool color = true;
+	static const int maxLevel = 255;
+
+	static wide widen( const rgb8& val ) { return rgb(val); }
+	static rgb8 narrow( const wide& val ) { return rgb8(val); }
+};
+
+#endif
@@ -0,0 +1,192 @@
+/******************************************************************************\
+ PlanarImage holds a color image as three separate grayscale planes, one per
+ channel, instead of the interleaved r,g,b pixels of an ImageType<rgb> (which
+ is laid out like a P6 file).  Every plane is an ordinary ImageType of the
+ pixel's channel type (int for rgb, unsigned char for rgb8), so anything that
+ works one channel at a time runs as three plain grayscale passes whose inner
+ loops step through contiguous samples of one type.
+
+ split and merge convert to and from the interleaved layout a row at a time,
+ readImage and writeImage in imageIO.h go straight between a .ppm file and
+ the planes.  The planes all have the same N, M and Q.
+\******************************************************************************/
+
+#ifndef PLANAR_IMAGE
+#define PLANAR_IMAGE
+
+#include "image.h"
+#include "pixelKernels.h"
+
+template <class pType>
+class PlanarImage
+{
+public:
+	typedef typename pixelTraits<pType>::channel channel;
+
+	static_assert( pixelTraits<pType>::color,
+	    "PlanarImage is only for color pixels" );
+
+// CONSTRUCTORS ////////////////////////////////////////////////////////////////
+	// default constructor, three empty planes
+	PlanarImage();
+
+	// splits an interleaved image into planes
+	PlanarImage( const ImageType<pType>& );
+
+// IMAGE FUNCTIONS /////////////////////////////////////////////////////////////
+	// returns the N, M and Q values of the planes
+	void getImageInfo( int&, int&, int& ) const;
+
+	// sets N, M and Q of every plane, filled as described by the FillType
+	void setImageInfo( int, int, int, FillType=FILL_BACKGROUND );
+
+	// name : getPlane
+	// input : a channel, 0 for red, 1 for green and 2 for blue
+	// output : the plane of that channel, throws a string for any other
+	//          channel
+	ImageType<channel>& getPlane( int );
+	const ImageType<channel>& getPlane( int ) const;
+
+	// name : split
+	// input : an interleaved color image
+	// output : resizes the planes to match and copies each channel into its
+	//          own plane
+	void split( const ImageType<pType>& );
+
+	// name : merge
+	// input : an interleaved color image
+	// output : resizes it to match the planes and interleaves them into it
+	void merge( ImageType<pType>& ) const;
+
+	// the same operations as ImageType, done to each plane on its own
+	void negateImage();
+	void enlargeImage( double, const PlanarImage<pType>& );
+	void resampleImage( int, int, const PlanarImage<pType>&, int );
+	void shrinkImage( double, const PlanarImage<pType>& );
+	void boxFilter( int, const PlanarImage<pType>& );
+
+private:
+	ImageType<channel> plane[3];
+};
+
+template <class pType>
+PlanarImage<pType>::PlanarImage()
+{
+}
+
+template <class pType>
+PlanarImage<pType>::PlanarImage( const ImageType<pType>& img )
+{
+	split( img );
+}
+
+template <class pType>
+void PlanarImage<pType>::getImageInfo( int& rows, int& cols, int& levels )
+	const
+{
+	plane[0].getImageInfo( rows, cols, levels );
+}
+
+template <class pType>
+void PlanarImage<pType>::setImageInfo( int rows, int cols, int levels,
+	FillType fill )
+{
+	for ( int c = 0; c < 3; c++ )
+		plane[c].setImageInfo( rows, cols, levels, fill );
+}
+
+template <class pType>
+ImageType<typename PlanarImage<pType>::channel>& PlanarImage<pType>::getPlane(
+	int c )
+{
+	if ( c < 0 || c > 2 )
+		throw (string)"There are only three planes!";
+
+	return plane[c];
+}
+
+template <class pType>
+const ImageType<typename PlanarImage<pType>::channel>&
+	PlanarImage<pType>::getPlane( int c ) const
+{
+	if ( c < 0 || c > 2 )
+		throw (string)"There are only three planes!";
+
+	return plane[c];
+}
+
+/******************************************************************************\
+ rgb and rgb8 are three packed channels, so a row of M pixels is 3*M samples
+ for the kernels in pixelKernels.h
+\******************************************************************************/
+template <class pType>
+void PlanarImage<pType>::split( const ImageType<pType>& img )
+{
+	int N, M, Q;
+
+	img.getImageInfo( N, M, Q );
+	setImageInfo( N, M, Q, FILL_NONE );
+
+	parallelFor( N, 16, [&]( int first, int last )
+	{
+		for ( int i = first; i < last; i++ )
+			splitChannels( reinterpret_cast<const channel*>( img.getRow(i) ),
+			    plane[0].getRow(i), plane[1].getRow(i), plane[2].getRow(i),
+			    M );
+	} );
+}
+
+template <class pType>
+void PlanarImage<pType>::merge( ImageType<pType>& img ) const
+{
+	int N, M, Q;
+
+	getImageInfo( N, M, Q );
+	img.setImageInfo( N, M, Q, FILL_NONE );
+
+	parallelFor( N, 16, [&]( int first, int last )
+	{
+		for ( int i = first; i < last; i++ )
+			mergeChannels( plane[0].getRow(i), plane[1].getRow(i),
+			    plane[2].getRow(i), reinterpret_cast<channel*>( img.getRow(i) ),
+			    M );
+	} );
+}
+
+template <class pType>
+void PlanarImage<pType>::negateImage()
+{
+	for ( int c = 0; c < 3; c++ )
+		plane[c].negateImage();
+}
+
+template <class pType>
+void PlanarImage<pType>::enlargeImage( double S, const PlanarImage<pType>& old )
+{
+	for ( int c = 0; c < 3; c++ )
+		plane[c].enlargeImage( S, old.plane[c] );
+}
+
+template <class pType>
+void PlanarImage<pType>::resampleImage( int rows, int cols,
+	const PlanarImage<pType>& old, int filter )
+{
+	for ( int c = 0; c < 3; c++ )
+		plane[c].resampleImage( rows, cols, old.plane[c], filter );
+}
+
+template <class pType>
+void PlanarImage<pType>::shrinkImage( double S, const PlanarImage<pType>& old )
+{
+	for ( int c = 0; c < 3; c++ )
+		plane[c].shrinkImage( S, old.plane[c] );
+}
+
+template <class pType>
+void PlanarImage<pType>::boxFilter( int r, const PlanarImage<pType>& old )
+{
+	for ( int c = 0; c < 3; c++ )
+		plane[c].boxFilter( r, old.plane[c] );
+}
+
+#endif
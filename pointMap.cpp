@@ -0,0 +1,140 @@
+#include <cmath>
+#include <string>
+#include <algorithm>
+#include "pointMap.h"
+
+using namespace std;
+
+/******************************************************************************\
+ default constructor, an empty identity map
+\******************************************************************************/
+PointMap::PointMap()
+	: Q( 0 ), channels( 1 ), table( 1, 0 )
+{
+	func = []( int value, int ) { return value; };
+}
+
+PointMap::PointMap( int levels, int chans, const Function& f )
+	: Q( levels ), channels( chans ), func( f )
+{
+	if ( Q < 0 )
+		throw (string)"A point map needs a Q of at least 0!";
+	if ( channels != 1 && channels != 3 )
+		throw (string)"A point map is for 1 or 3 channels!";
+
+	if ( Q > MAX_MAP_LEVELS )
+		return;
+
+	table.resize( (long)( Q+1 ) * channels );
+
+	for ( int v = 0; v <= Q; v++ )
+		for ( int c = 0; c < channels; c++ )
+			table[(long)v*channels + c] = func( v, c );
+}
+
+PointMap PointMap::identity( int Q, int channels )
+{
+	return PointMap( Q, channels, []( int value, int ) { return value; } );
+}
+
+PointMap PointMap::negate( int Q, int channels )
+{
+	return PointMap( Q, channels, [Q]( int value, int )
+	{
+		return Q - value;
+	} );
+}
+
+PointMap PointMap::threshold( int Q, int channels, int level )
+{
+	return PointMap( Q, channels, [Q, level]( int value, int )
+	{
+		return value < level ? 0 : Q;
+	} );
+}
+
+PointMap PointMap::gamma( int Q, int channels, double g )
+{
+	if ( !( g > 0 ) )
+		throw (string)"Gamma has to be above 0!";
+
+	return PointMap( Q, channels, [Q, g]( int value, int )
+	{
+		if ( Q == 0 )
+			return 0;
+
+		double v = min( max( value, 0 ), Q ) / (double)Q;
+		return (int)floor( Q * pow( v, g ) + 0.5 );
+	} );
+}
+
+PointMap PointMap::stretch( int Q, int channels, int low, int high )
+{
+	if ( high <= low )
+		throw (string)"The range to stretch is empty!";
+
+	return PointMap( Q, channels, [Q, low, high]( int value, int )
+	{
+		if ( value <= low )
+			return 0;
+		if ( value >= high )
+			return Q;
+
+		return (int)floor( (double)( value - low ) * Q / ( high - low ) +
+		    0.5 );
+	} );
+}
+
+int PointMap::getLevels() const
+{
+	return Q;
+}
+
+int PointMap::getChannels() const
+{
+	return channels;
+}
+
+bool PointMap::hasTable() const
+{
+	return !table.empty();
+}
+
+const int *PointMap::getTable() const
+{
+	return table.empty() ? NULL : &table[0];
+}
+
+int PointMap::map( int value, int channel ) const
+{
+	if ( value >= 0 && value <= Q && !table.empty() )
+		return table[(long)value*channels + channel];
+
+	return func( value, channel );
+}
+
+/******************************************************************************\
+ the table of the combined map is this table run through the next map, only
+ the values off the table need both functions
+\******************************************************************************/
+PointMap PointMap::then( const PointMap& next ) const
+{
+	if ( next.Q != Q || next.channels != channels )
+		throw (string)"Point maps are for different images!";
+
+	PointMap result;
+	Function first = func, second = next.func;
+
+	result.Q = Q;
+	result.channels = channels;
+	result.func = [first, second]( int value, int c )
+	{
+		return second( first( value, c ), c );
+	};
+	result.table.resize( table.size() );
+
+	for ( size_t i = 0; i < table.size(); i++ )
+		result.table[i] = next.map( table[i], i % channels );
+
+	return result;
+}
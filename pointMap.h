@@ -0,0 +1,163 @@
+/******************************************************************************\
+ PointMap is an operation that changes every pixel on its own, by a function
+ of its value alone (negating, thresholding, gamma, contrast stretches...).
+ An image with Q levels can only hold the values 0 to Q in each channel, so
+ the function is worked out once for each of them and kept in a table, and
+ ImageType::applyMap changes a pixel with a single lookup however costly the
+ function is.  Color images have a table per channel.
+
+ Values outside [0,Q] (which int and rgb images can hold) aren't in the
+ table, they go through the function itself.  Images with more than
+ MAX_MAP_LEVELS levels get no table at all and every value goes through the
+ function.
+
+ Maps for the same Q and channels are combined with then, a.then( b ) does
+ a and then b with one lookup.  Values are not clipped between the two.
+\******************************************************************************/
+
+#ifndef POINTMAP_H
+#define POINTMAP_H
+
+#include <vector>
+#include <functional>
+#include <string>
+#include "pixelTraits.h"
+#include "pixelKernels.h"
+
+// the most levels a table is built for
+const int MAX_MAP_LEVELS = 65535;
+
+class PointMap
+{
+public:
+	// the function of a map, takes a value and the channel it's in (0 for
+	// grayscale, 0 to 2 for red, green and blue) and returns the new value
+	typedef std::function<int( int, int )> Function;
+
+// CONSTRUCTORS ////////////////////////////////////////////////////////////////
+	// default constructor, the identity of a grayscale image with 0 levels
+	PointMap();
+
+	// name : PointMap
+	// input : Q, the number of channels (1 or 3) and the function
+	// output : works out the table of the function for the values 0 to Q,
+	//          throws a string for a negative Q or another number of
+	//          channels
+	PointMap( int, int, const Function& );
+
+	// the built in maps, each takes Q and the number of channels first
+
+	// leaves every value alone
+	static PointMap identity( int, int );
+
+	// Q - value, the same as ImageType::negateImage
+	static PointMap negate( int, int );
+
+	// 0 below the level passed and Q from it up, the same as
+	// ImageType::threshold on a grayscale image
+	static PointMap threshold( int, int, int );
+
+	// Q * (value/Q)^gamma rounded, values outside [0,Q] are clipped first.
+	// gamma below 1 brightens, above 1 darkens.  Throws a string for a gamma
+	// that isn't positive
+	static PointMap gamma( int, int, double );
+
+	// stretches the range [low,high] over [0,Q], values outside of it are
+	// clipped to 0 or Q.  Throws a string if high isn't above low
+	static PointMap stretch( int, int, int, int );
+
+// MAP FUNCTIONS ///////////////////////////////////////////////////////////////
+	// Q and number of channels the map was made for
+	int getLevels() const;
+	int getChannels() const;
+
+	// true if the map has a table, it has Q+1 rows of one value per channel
+	bool hasTable() const;
+	const int *getTable() const;
+
+	// name : map
+	// input : a value and its channel
+	// output : the new value, from the table if it's in there
+	int map( int, int ) const;
+
+	// name : then
+	// input : a map with the same Q and channels
+	// output : the map that does this one and then that one, throws a string
+	//          if they don't match
+	PointMap then( const PointMap& ) const;
+
+private:
+	int Q;
+	int channels;
+	std::vector<int> table;		// ( Q+1 ) x channels, empty if Q is too big
+	Function func;
+};
+
+/******************************************************************************\
+ RowMap runs rows of pixels through a PointMap.  The table is copied into the
+ channel type of the pixel and saturated once, a row is then one run of
+ samples for lookupSamples (three per pixel for color, in the r,g,b order of
+ the table).  A sample that isn't in the table goes through the map's function
+ along with the rest of its pixel, and the run carries on from the next pixel
+\******************************************************************************/
+template <class pType>
+class RowMap
+{
+public:
+	typedef typename pixelTraits<pType>::channel channel;
+	typedef pixelTraits<channel> channelTraits;
+
+	// number of channels in a pixel
+	static const int C = pixelTraits<pType>::color ? 3 : 1;
+
+	// name : RowMap
+	// input : a map with C channels
+	// output : copies its table, throws a string if the channels don't match
+	RowMap( const PointMap& );
+
+	// name : apply
+	// input : a row of pixels and its length
+	// output : changes every pixel by the map, saturated to the pixel type
+	void apply( pType[], int ) const;
+
+private:
+	PointMap map;
+	std::vector<channel> table;	// empty if the map has no table
+	int levels;					// rows in table
+};
+
+template <class pType>
+RowMap<pType>::RowMap( const PointMap& m )
+	: map( m ), levels( 0 )
+{
+	if ( map.getChannels() != C )
+		throw (std::string)"Point map doesn't match the image!";
+
+	if ( map.hasTable() )
+	{
+		levels = map.getLevels() + 1;
+		table.resize( (long)levels * C );
+		for ( size_t k = 0; k < table.size(); k++ )
+			table[k] = channelTraits::narrow( map.getTable()[k] );
+	}
+}
+
+template <class pType>
+void RowMap<pType>::apply( pType pixels[], int M ) const
+{
+	channel *row = reinterpret_cast<channel*>( pixels );
+	long n = (long)M * C;
+	long j = 0;
+
+	while ( true )
+	{
+		j += lookupSamples( table.data(), levels, C, row + j, row + j, n - j );
+		if ( j == n )
+			break;
+
+		for ( long end = j - j % C + C; j < end; j++ )
+			row[j] = channelTraits::narrow( map.map( row[j], j % C ) );
+	}
+}
+
+#endif
@@ -0,0 +1,123 @@
+#include "resampler.h"
+
+/******************************************************************************\
+ the output positions are mapped onto the spline exactly the way enlargeImage
+ always has, position k of out is at (k - S/2) / (out - S - 1) * 100 where S
+ is the scale out/in.  The spline's interval and weights for that position
+ are the terms of cubicSpline::getVal, grouped by the value they multiply
+\******************************************************************************/
+Resampler::Resampler( int inSamples, int outSamples )
+	: in( inSamples ), out( outSamples )
+{
+	int len = in - 2;
+	double S = (double)out / in;
+
+	h = 100.0 / ( in - 1 );
+
+	// factor the system h*m[i-1] + 4h*m[i] + h*m[i+1] = B[i] once, the
+	// same elimination solveTriDiag does for every spline
+	upper.resize( len );
+	invPivot.resize( len );
+
+	for ( int i = 0; i < len; i++ )
+	{
+		double pivot = 4*h - ( i > 0 ? h*upper[i-1] : 0 );
+		invPivot[i] = 1.0 / pivot;
+		upper[i] = h / pivot;
+	}
+
+	knot.resize( out );
+	wm0.resize( out );
+	wm1.resize( out );
+	wy0.resize( out );
+	wy1.resize( out );
+
+	for ( int k = 0; k < out; k++ )
+	{
+		double x = ( k - S/2.0 ) / ( out - S - 1.0 ) * 100.0;
+		int i = (int)( x/h );
+
+		// past either end just use the closest curve
+		if ( i >= len+1 )
+			i = len;
+		if ( i < 0 )
+			i = 0;
+
+		double right = ( i+1 )*h - x;
+		double left = x - i*h;
+
+		knot[k] = i;
+		wm0[k] = right*right*right / ( 6*h ) - right*h/6;
+		wm1[k] = left*left*left / ( 6*h ) - left*h/6;
+		wy0[k] = right / h;
+		wy1[k] = left / h;
+	}
+}
+
+int Resampler::inSize() const
+{
+	return in;
+}
+
+int Resampler::outSize() const
+{
+	return out;
+}
+
+/******************************************************************************\
+ a natural spline has a zero second derivative at both ends, the ones in
+ between come from a forward and a backward sweep over the precomputed
+ factors.  Every column is swept together so the inner loops run along rows
+\******************************************************************************/
+void Resampler::solve( const double y[], double m[], long width ) const
+{
+	solve( y, m, width, 0, width );
+}
+
+void Resampler::solve( const double y[], double m[], long width, long first,
+	long last ) const
+{
+	int len = in - 2;
+
+	for ( long w = first; w < last; w++ )
+	{
+		m[w] = 0;
+		m[( in-1 )*width + w] = 0;
+	}
+
+	// forward sweep, m[i+1] holds the eliminated right hand side for now
+	for ( int i = 0; i < len; i++ )
+	{
+		const double *y0 = y + i*width;
+		const double *y1 = y0 + width;
+		const double *y2 = y1 + width;
+		const double *prev = m + i*width;
+		double *cur = m + ( i+1 )*width;
+		double lower = ( i > 0 ? h : 0 );
+
+		for ( long w = first; w < last; w++ )
+			cur[w] = ( 6/h*( ( y2[w]-y1[w] ) - ( y1[w]-y0[w] ) ) -
+			    lower*prev[w] ) * invPivot[i];
+	}
+
+	// back substitution
+	for ( int i = len - 2; i >= 0; i-- )
+	{
+		double *cur = m + ( i+1 )*width;
+		const double *next = cur + width;
+
+		for ( long w = first; w < last; w++ )
+			cur[w] -= upper[i]*next[w];
+	}
+}
+
+void Resampler::evaluate( const double y[], const double m[], long width,
+	int k, double dst[] ) const
+{
+	long base = knot[k]*width;
+	const double *y0 = y + base, *y1 = y0 + width;
+	const double *m0 = m + base, *m1 = m0 + width;
+
+	for ( long w = 0; w < width; w++ )
+		dst[w] = wm0[k]*m0[w] + wm1[k]*m1[w] + wy0[k]*y0[w] + wy1[k]*y1[w];
+}
@@ -0,0 +1,70 @@
+/******************************************************************************\
+ Resampler stretches samples along one axis of an image with the same natural
+ cubic spline cubicSpline builds, but everything that only depends on the
+ size of the axis is worked out once:
+
+   - the factors of the spline's tri-diagonal system, so solving a spline is
+     just one forward and one backward sweep with no divisions
+   - for every output position, the interval it falls in and the four
+     weights that combine the two samples at the ends of the interval with
+     their second derivatives
+
+ The same object works on a single row (interleaved channels) or on a whole
+ block of rows at once, which is how the columns of an image are stretched
+ without ever walking down a column.  Data is laid out as "in" rows of
+ "width" values each, value w of row i is at i*width + w.  A row of M rgb
+ pixels is M rows of width 3, the columns of an image M*3 wide are image
+ rows of width M*3.
+\******************************************************************************/
+
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <vector>
+
+class Resampler
+{
+public:
+	// name : Resampler
+	// input : number of samples along the axis before and after resampling
+	//         (there must be at least 4 before)
+	// output : precomputes the spline factors and the taps of every output
+	Resampler( int, int );
+
+	// number of samples before and after resampling
+	int inSize() const;
+	int outSize() const;
+
+	// name : solve
+	// input : in rows of width samples, an array the same size and width,
+	//         optionally only the columns [first,last) are solved
+	// output : fills the second array with the second derivative of the
+	//          spline through each column of the first
+	void solve( const double[], double[], long ) const;
+	void solve( const double[], double[], long, long, long ) const;
+
+	// name : evaluate
+	// input : the samples and second derivatives from solve, width, the
+	//         output position and an array of width values
+	// output : sets the array to the spline's value at the output position
+	//          for every column
+	void evaluate( const double[], const double[], long, int, double[] )
+	    const;
+
+private:
+	int in, out;
+
+	// spline knots are h apart on the [0,100] scale cubicSpline uses
+	double h;
+
+	// tri-diagonal factors, one per unknown second derivative
+	std::vector<double> upper;		// modified upper diagonal
+	std::vector<double> invPivot;	// 1 / modified diagonal
+
+	// for every output position, the first knot of its interval and the
+	// weights of the two second derivatives and the two samples
+	std::vector<int> knot;
+	std::vector<double> wm0, wm1, wy0, wy1;
+};
+
+#endif
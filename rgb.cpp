@@ -38,6 +38,15 @@ rgb::rgb( const int& rhs){
 
 }
 
+//widens a packed color
+rgb::rgb( const rgb8& rhs){
+
+	r = rhs.r;
+	g = rhs.g;
+	b = rhs.b;
+
+}
+
 // same as copy 
 rgb& rgb::operator= ( const rgb& rhs){
 
@@ -68,7 +77,7 @@ rgb& rgb::operator= ( const int& rhs){
 }
 
 // Operator +
-rgb rgb::operator+(const int& rhs){
+rgb rgb::operator+(const int& rhs)const{
 	rgb temp;
 
 	temp.r = r + rhs;
@@ -78,7 +87,7 @@ rgb rgb::operator+(const int& rhs){
 	return temp;
 }
 
-rgb rgb::operator+(const rgb& rhs){
+rgb rgb::operator+(const rgb& rhs)const{
 	rgb temp;
 
 	temp.r = r + rhs.r;
@@ -89,7 +98,7 @@ rgb rgb::operator+(const rgb& rhs){
 }
 
 // Operator -
-rgb rgb::operator-(const int& rhs){
+rgb rgb::operator-(const int& rhs)const{
 	rgb temp;
 
 	temp.r = r - rhs;
@@ -99,7 +108,7 @@ rgb rgb::operator-(const int& rhs){
 	return temp;
 }
 
-rgb rgb::operator-(const rgb& rhs){
+rgb rgb::operator-(const rgb& rhs)const{
 	rgb temp;
 
 	temp.r = r - rhs.r;
@@ -110,7 +119,7 @@ rgb rgb::operator-(const rgb& rhs){
 }
 
 // Operator /
-rgb rgb::operator/(const int& rhs){
+rgb rgb::operator/(const int& rhs)const{
 	rgb temp;
 
 	temp.r = r / rhs;
@@ -120,7 +129,7 @@ rgb rgb::operator/(const int& rhs){
 	return temp;
 }
 
-rgb rgb::operator/(const rgb& rhs){
+rgb rgb::operator/(const rgb& rhs)const{
 	rgb temp;
 
 	temp.r = r / rhs.r;
@@ -131,7 +140,7 @@ rgb rgb::operator/(const rgb& rhs){
 }
 
 // Operator *
-rgb rgb::operator*(const double& rhs){
+rgb rgb::operator*(const double& rhs)const{
 	rgb temp;
 
 	temp.r = r * rhs;
@@ -141,7 +150,7 @@ rgb rgb::operator*(const double& rhs){
 	return temp;
 }
 
-rgb rgb::operator*(const int& rhs){
+rgb rgb::operator*(const int& rhs)const{
 	rgb temp;
 
 	temp.r = r * rhs;
@@ -151,7 +160,7 @@ rgb rgb::operator*(const int& rhs){
 	return temp;
 }
 
-rgb rgb::operator*(const rgb& rhs){
+rgb rgb::operator*(const rgb& rhs)const{
 	rgb temp;
 
 	temp.r = r * rhs.r;
@@ -316,7 +325,160 @@ int toInt( const rgb& rhs )
 	return (rhs.r + rhs.g + rhs.b)/3;
 }
 
+int toInt( const rgb8& rhs )
+{
+	return (rhs.r + rhs.g + rhs.b)/3;
+}
+
 int toInt( const int& rhs )
 {
 	return rhs;
 }
+
+/******************************************************************************\
+                                     rgb8
+\******************************************************************************/
+
+// clamp a value to the range of an 8 bit channel
+static unsigned char sat8( int val )
+{
+	if ( val < 0 )
+		return 0;
+	if ( val > 255 )
+		return 255;
+	return (unsigned char)val;
+}
+
+// default construtor, sets to 0
+rgb8::rgb8(){
+
+	r = 0;
+	g = 0;
+	b = 0;
+
+}
+
+// parameterized constructor, clamps values
+rgb8::rgb8(int rVal, int gVal, int bVal){
+
+	r = sat8(rVal);
+	g = sat8(gVal);
+	b = sat8(bVal);
+
+}
+
+//allows to be intialized like an integer
+rgb8::rgb8( const int& rhs){
+
+	r = g = b = sat8(rhs);
+
+}
+
+//narrows an rgb
+rgb8::rgb8( const rgb& rhs){
+
+	r = sat8(rhs.r);
+	g = sat8(rhs.g);
+	b = sat8(rhs.b);
+
+}
+
+//  operator = 
+rgb8& rgb8::operator= ( const int& rhs){
+
+	r = g = b = sat8(rhs);
+
+	return *this;
+}
+
+// Operator +
+rgb8 rgb8::operator+(const int& rhs)const{
+
+	return rgb8( r + rhs, g + rhs, b + rhs );
+}
+
+rgb8 rgb8::operator+(const rgb8& rhs)const{
+
+	return rgb8( r + rhs.r, g + rhs.g, b + rhs.b );
+}
+
+// Operator -
+rgb8 rgb8::operator-(const int& rhs)const{
+
+	return rgb8( r - rhs, g - rhs, b - rhs );
+}
+
+rgb8 rgb8::operator-(const rgb8& rhs)const{
+
+	return rgb8( r - rhs.r, g - rhs.g, b - rhs.b );
+}
+
+// Operator /
+rgb8 rgb8::operator/(const int& rhs)const{
+
+	return rgb8( r / rhs, g / rhs, b / rhs );
+}
+
+// Operator *
+rgb8 rgb8::operator*(const int& rhs)const{
+
+	return rgb8( r * rhs, g * rhs, b * rhs );
+}
+
+rgb8 rgb8::operator*(const double& rhs)const{
+
+	return rgb8( (int)(r * rhs), (int)(g * rhs), (int)(b * rhs) );
+}
+
+//operator +=
+void rgb8::operator+=(const rgb8& rhs){
+
+	*this = *this + rhs;
+}
+
+//operator -=
+void rgb8::operator-=(const rgb8& rhs){
+
+	*this = *this - rhs;
+}
+
+// comparisons are done the same way rgb does them
+bool rgb8::operator<(const rgb8& rhs)const{
+
+	return rgb(*this) < rgb(rhs);
+}
+
+bool rgb8::operator<(const int& rhs)const{
+
+	return rgb(*this) < rhs;
+}
+
+bool rgb8::operator>(const rgb8& rhs)const{
+
+	return rgb(*this) > rgb(rhs);
+}
+
+bool rgb8::operator>(const int& rhs)const{
+
+	return rgb(*this) > rhs;
+}
+
+bool rgb8::operator==(const rgb8& rhs)const{
+
+	return rgb(*this) == rgb(rhs);
+}
+
+bool rgb8::operator==(const int& rhs)const{
+
+	return rgb(*this) == rhs;
+}
+
+bool rgb8::operator!=(const rgb8& rhs)const{
+
+	return rgb(*this) != rgb(rhs);
+}
+
+bool rgb8::operator!=(const int& rhs)const{
+
+	return rgb(*this) != rhs;
+}
@@ -3,6 +3,8 @@
 
 #include <cstdlib>
 
+class rgb8;
+
 class rgb{
 
 	public:
@@ -20,6 +22,9 @@ class rgb{
 		// allows to be initialized as integer
 		rgb( const int& );
 
+		// widens a packed 8 bit color
+		rgb( const rgb8& );
+
 		// same as copy 
 		rgb& operator= ( const rgb& );
 
@@ -30,23 +35,23 @@ class rgb{
 
 		rgb& operator= (const int& );
 		
-		rgb operator+(const int& );
+		rgb operator+(const int& )const;
 
-		rgb operator+(const rgb& );
+		rgb operator+(const rgb& )const;
 
-		rgb operator-(const int& );
+		rgb operator-(const int& )const;
 
-		rgb operator-(const rgb& );
+		rgb operator-(const rgb& )const;
 
-		rgb operator/(const int& );
+		rgb operator/(const int& )const;
 
-		rgb operator/(const rgb& );
+		rgb operator/(const rgb& )const;
 
-		rgb operator*(const int& );
+		rgb operator*(const int& )const;
 		
-		rgb operator*(const double& );
+		rgb operator*(const double& )const;
 		
-		rgb operator*(const rgb& );
+		rgb operator*(const rgb& )const;
 
 		void operator+=(const rgb& );
 
@@ -81,7 +86,74 @@ class rgb{
 
 rgb abs( const rgb& );
 
+/******************************************************************************\
+ rgb8 is a packed 3 byte color pixel (one unsigned char per channel), it is
+ laid out exactly like a pixel in a P6 file.  All of the arithmetic saturates
+ to the range [0,255] instead of wrapping around.  Comparisons behave the same
+ way they do for rgb.
+\******************************************************************************/
+class rgb8{
+
+	public:
+
+// CONSTRUCTORS ////////////////////////////////////////////////////////////////
+		// default construtor, sets to 0
+		rgb8();
+
+		// parameterized constructor, each value is clamped to [0,255]
+		rgb8(int, int, int);
+
+		// allows to be initialized as integer (clamped)
+		rgb8( const int& );
+
+		// narrows an rgb, clamping each channel
+		explicit rgb8( const rgb& );
+
+// OPERATORS ///////////////////////////////////////////////////////////////////
+
+		rgb8& operator= (const int& );
+
+		rgb8 operator+(const int& )const;
+
+		rgb8 operator+(const rgb8& )const;
+
+		rgb8 operator-(const int& )const;
+
+		rgb8 operator-(const rgb8& )const;
+
+		rgb8 operator/(const int& )const;
+
+		rgb8 operator*(const int& )const;
+
+		rgb8 operator*(const double& )const;
+
+		void operator+=(const rgb8& );
+
+		void operator-=(const rgb8& );
+
+		bool operator<(const rgb8& )const;
+
+		bool operator<(const int& )const;
+
+		bool operator>(const rgb8& )const;
+
+		bool operator>(const int& )const;
+
+		bool operator==(const rgb8& )const;
+
+		bool operator==(const int& )const;
+
+		bool operator!=(const rgb8& )const;
+
+		bool operator!=(const int& )const;
+
+		unsigned char r; // red value
+		unsigned char g; // green value
+		unsigned char b; // blue value
+};
+
 int toInt( const rgb& );
+int toInt( const rgb8& );
 int toInt( const int& );
 
 #endif
@@ -0,0 +1,87 @@
+/******************************************************************************\
+ SampleStats is the running count, sum, sum of squares, minimum and maximum
+ of the samples of one channel, everything needed for the mean and variance
+ (and the range) of that channel in a single pass.
+
+ Sums are never kept in the pixel type.  The sum is a 64 bit integer, every
+ sample fits in an int and an image has fewer than 2^31 pixels, so it is
+ exact.  The sum of squares is a double, the kernels add each row up in
+ separate vector lanes and the rows are then added in pairs, pairs of pairs
+ and so on by addPairwise, so its rounding error grows with the log of the
+ number of rows instead of the number of pixels (it is exact for 8 and 16
+ bit rows).
+\******************************************************************************/
+
+#ifndef SAMPLE_STATS_H
+#define SAMPLE_STATS_H
+
+#include <climits>
+
+struct SampleStats
+{
+	long long count;			// number of samples
+	long long sum;				// sum of the samples
+	double squares;				// sum of the squares of the samples
+	int min;					// INT_MAX while there are no samples
+	int max;					// INT_MIN while there are no samples
+
+	SampleStats()
+		: count( 0 ), sum( 0 ), squares( 0 ), min( INT_MAX ), max( INT_MIN )
+	{
+	}
+
+	// adds one sample
+	void add( int val )
+	{
+		count++;
+		sum += val;
+		squares += (double)val * val;
+		if ( val < min ) min = val;
+		if ( val > max ) max = val;
+	}
+
+	// adds the samples counted by another
+	void add( const SampleStats& rhs )
+	{
+		count += rhs.count;
+		sum += rhs.sum;
+		squares += rhs.squares;
+		if ( rhs.min < min ) min = rhs.min;
+		if ( rhs.max > max ) max = rhs.max;
+	}
+
+	// the mean truncated toward 0 like integer division, 0 with no samples
+	int intMean() const
+	{
+		return count == 0 ? 0 : (int)( sum / count );
+	}
+
+	double mean() const
+	{
+		return count == 0 ? 0 : (double)sum / count;
+	}
+
+	// population variance, 0 with no samples
+	double variance() const
+	{
+		if ( count == 0 )
+			return 0;
+
+		double var = ( squares - mean() * sum ) / count;
+		return var < 0 ? 0 : var;
+	}
+};
+
+// name : addPairwise
+// input : n groups of stats (one per channel, channels per group)
+// output : adds the groups up in pairs, then pairs of pairs and so on, the
+//          totals end up in the first group
+inline void addPairwise( SampleStats stats[], long n, int channels )
+{
+	for ( long step = 1; step < n; step *= 2 )
+		for ( long i = 0; i + step < n; i += 2*step )
+			for ( int c = 0; c < channels; c++ )
+				stats[i*channels + c].add( stats[( i+step )*channels + c] );
+}
+
+#endif
@@ -0,0 +1,303 @@
+/******************************************************************************\
+ SummedAreaTable holds, for every corner (i,j) of an image's pixel grid, the
+ sum of all the pixels above and to the left of it.  The sum over any
+ rectangle of the image is then four lookups however big the rectangle is,
+ which makes box filters, region means and shrinking cost the same for any
+ size of block.
+
+ Pixels are treated as unit squares, pixel (i,j) covers [i,i+1) x [j,j+1).
+ Inside a pixel the sum up to a point grows linearly in each direction, so
+ the sum up to a fractional corner is the bilinear blend of the table at the
+ four whole corners around it, and rectangles with fractional corners get
+ exact area weighted sums as well.
+
+ Sums are kept per channel (3 for rgb) in 64 bits so no image can overflow
+ them, the table takes (N+1) x (M+1) x channels long longs.
+
+ A table can also be built for a band of rows of a bigger image, carrying on
+ from the sums of every row above the band.  Its corners are then the same
+ numbers the whole image's table has, rows are passed as rows of the whole
+ image, and every sum and mean inside the band comes out exactly as it would
+ from the whole table.
+\******************************************************************************/
+
+#ifndef SUMMEDAREA_H
+#define SUMMEDAREA_H
+
+#include <vector>
+#include <string>
+#include <cmath>
+#include <algorithm>
+#include "pixelTraits.h"
+#include "parallel.h"
+
+template <class pType> class ImageType;
+
+template <class pType>
+class SummedAreaTable
+{
+public:
+	typedef pixelTraits<pType> traits;
+	typedef typename traits::wide wide;
+
+	// number of ints (channels) in a wide value
+	static const int C = sizeof(wide) / sizeof(int);
+
+	// name : SummedAreaTable
+	// input : nothing, or the image to build the table of
+	// output : an empty table, or the table of the image
+	SummedAreaTable();
+	SummedAreaTable( const ImageType<pType>& );
+
+	// name : build
+	// input : an image, or a band of rows of a bigger image, the row of the
+	//         bigger image the band starts at and the (M+1) x C sums at that
+	//         row (cornerRow of the table of the band above)
+	// output : replaces the table with the one of the image or band
+	void build( const ImageType<pType>& );
+	void build( const ImageType<pType>&, int, const long long[] );
+
+	// name : cornerRow
+	// input : a row r of the image, inside the table's band
+	// output : the (M+1) x C sums over the rows above r
+	const long long *cornerRow( int ) const;
+
+	// name : getSize
+	// input : two ints
+	// output : set to the rows and cols of the image the table was built from
+	void getSize( int&, int& ) const;
+
+	// name : sum, mean
+	// input : the upper left and lower right corners of a region (the same
+	//         corners getSubImage takes, the lower right is just outside it),
+	//         and an array of C values for sum
+	// output : sum sets the array to the total of each channel over the
+	//          region, mean returns the average pixel rounded to the nearest
+	//          level.  Corners are clipped to the image, mean throws a string
+	//          if nothing is left
+	void sum( int, int, int, int, long long[] ) const;
+	wide mean( int, int, int, int ) const;
+
+	// name : areaSum, areaMean
+	// input : the same corners as fractional positions, and an array of C
+	//         values for areaSum
+	// output : the same as sum and mean with every pixel weighted by how
+	//          much of it is covered
+	void areaSum( double, double, double, double, double[] ) const;
+	wide areaMean( double, double, double, double ) const;
+
+private:
+	// the C sums at corner (i,j), i is a row of the image
+	const long long *corner( int i, int j ) const
+	    { return &table[( (long)( i-top )*( M+1 ) + j )*C]; }
+
+	// the C sums over [0,r) x [0,c), r and c are clipped to the image
+	void integral( double, double, double[] ) const;
+
+	int N, M;
+	int top;						// row of the image the table starts at
+	std::vector<long long> table;	// (N+1) rows of (M+1)*C sums
+};
+
+template <class pType>
+SummedAreaTable<pType>::SummedAreaTable()
+	: N( 0 ), M( 0 ), top( 0 )
+{
+}
+
+template <class pType>
+SummedAreaTable<pType>::SummedAreaTable( const ImageType<pType>& img )
+	: N( 0 ), M( 0 ), top( 0 )
+{
+	build( img );
+}
+
+template <class pType>
+void SummedAreaTable<pType>::build( const ImageType<pType>& img )
+{
+	build( img, 0, NULL );
+}
+
+/******************************************************************************\
+ every row is summed across on its own (rows in parallel), then the rows are
+ added down the image a band of columns at a time.  A band's first row of
+ corners is the sums above it, so adding down carries them through
+\******************************************************************************/
+template <class pType>
+void SummedAreaTable<pType>::build( const ImageType<pType>& img, int first,
+	const long long above[] )
+{
+	int Q;
+	long width;
+
+	img.getImageInfo( N, M, Q );
+	top = first;
+	width = (long)( M+1 ) * C;
+	table.assign( ( N+1 ) * width, 0 );
+
+	if ( above != NULL )
+		std::copy( above, above + width, table.begin() );
+
+	parallelFor( N, 8, [&]( int first, int last )
+	{
+		for ( int i = first; i < last; i++ )
+		{
+			const pType *src = img.getRow(i);
+			long long *row = &table[( i+1 )*width];
+
+			for ( int j = 0; j < M; j++ )
+			{
+				wide v = traits::widen( src[j] );
+				const int *in = reinterpret_cast<const int*>( &v );
+
+				for ( int k = 0; k < C; k++ )
+					row[( j+1 )*C + k] = row[j*C + k] + in[k];
+			}
+		}
+	} );
+
+	parallelFor( width, 1024, [&]( int first, int last )
+	{
+		for ( int i = 1; i <= N; i++ )
+		{
+			const long long *above = &table[( i-1 )*width];
+			long long *row = &table[i*width];
+
+			for ( int w = first; w < last; w++ )
+				row[w] += above[w];
+		}
+	} );
+}
+
+template <class pType>
+void SummedAreaTable<pType>::getSize( int& rows, int& cols ) const
+{
+	rows = N;
+	cols = M;
+}
+
+template <class pType>
+const long long *SummedAreaTable<pType>::cornerRow( int r ) const
+{
+	if ( r < top || r > top + N )
+		throw (std::string)"Row isn't in the summed area table!";
+
+	return corner( r, 0 );
+}
+
+template <class pType>
+void SummedAreaTable<pType>::sum( int ULr, int ULc, int LRr, int LRc,
+	long long total[] ) const
+{
+	ULr = std::min( std::max( ULr, top ), top + N );
+	LRr = std::min( std::max( LRr, ULr ), top + N );
+	ULc = std::min( std::max( ULc, 0 ), M );
+	LRc = std::min( std::max( LRc, ULc ), M );
+
+	const long long *a = corner( ULr, ULc ), *b = corner( ULr, LRc );
+	const long long *c = corner( LRr, ULc ), *d = corner( LRr, LRc );
+
+	for ( int k = 0; k < C; k++ )
+		total[k] = d[k] - b[k] - c[k] + a[k];
+}
+
+template <class pType>
+typename SummedAreaTable<pType>::wide SummedAreaTable<pType>::mean( int ULr,
+	int ULc, int LRr, int LRc ) const
+{
+	long long total[C];
+	long long area;
+	wide result;
+	int *out = reinterpret_cast<int*>( &result );
+
+	ULr = std::min( std::max( ULr, top ), top + N );
+	LRr = std::min( std::max( LRr, ULr ), top + N );
+	ULc = std::min( std::max( ULc, 0 ), M );
+	LRc = std::min( std::max( LRc, ULc ), M );
+
+	area = (long long)( LRr - ULr ) * ( LRc - ULc );
+	if ( area == 0 )
+		throw (std::string)"Region has no pixels to average!";
+
+	sum( ULr, ULc, LRr, LRc, total );
+
+	// round half up, sums of pixels are never negative
+	for ( int k = 0; k < C; k++ )
+		out[k] = (int)( ( total[k] + area/2 ) / area );
+
+	return result;
+}
+
+/******************************************************************************\
+ with r = i + a and c = j + b the sum up to (r,c) is
+   S(i,j) + a*( S(i+1,j) - S(i,j) ) + b*( S(i,j+1) - S(i,j) ) + a*b*pixel(i,j)
+ the differences are taken in 64 bits first so large sums don't swallow the
+ fractional parts
+\******************************************************************************/
+template <class pType>
+void SummedAreaTable<pType>::integral( double r, double c, double total[] )
+	const
+{
+	r = std::min( std::max( r, (double)top ), (double)( top + N ) );
+	c = std::min( std::max( c, 0.0 ), (double)M );
+
+	int i = std::min( (int)r, top + N-1 ), j = std::min( (int)c, M-1 );
+	double a = r - i, b = c - j;
+
+	const long long *s00 = corner( i, j ), *s01 = corner( i, j+1 );
+	const long long *s10 = corner( i+1, j ), *s11 = corner( i+1, j+1 );
+
+	for ( int k = 0; k < C; k++ )
+		total[k] = s00[k] + a*( s10[k] - s00[k] ) + b*( s01[k] - s00[k] ) +
+		    a*b*( s11[k] - s10[k] - s01[k] + s00[k] );
+}
+
+template <class pType>
+void SummedAreaTable<pType>::areaSum( double ULr, double ULc, double LRr,
+	double LRc, double total[] ) const
+{
+	double a[C], b[C], c[C], d[C];
+
+	if ( N == 0 || M == 0 )
+	{
+		for ( int k = 0; k < C; k++ )
+			total[k] = 0;
+		return;
+	}
+
+	integral( ULr, ULc, a );
+	integral( ULr, LRc, b );
+	integral( LRr, ULc, c );
+	integral( LRr, LRc, d );
+
+	for ( int k = 0; k < C; k++ )
+		total[k] = d[k] - b[k] - c[k] + a[k];
+}
+
+template <class pType>
+typename SummedAreaTable<pType>::wide SummedAreaTable<pType>::areaMean(
+	double ULr, double ULc, double LRr, double LRc ) const
+{
+	double total[C];
+	double area;
+	wide result;
+	int *out = reinterpret_cast<int*>( &result );
+
+	ULr = std::min( std::max( ULr, (double)top ), (double)( top + N ) );
+	LRr = std::min( std::max( LRr, ULr ), (double)( top + N ) );
+	ULc = std::min( std::max( ULc, 0.0 ), (double)M );
+	LRc = std::min( std::max( LRc, ULc ), (double)M );
+
+	area = ( LRr - ULr ) * ( LRc - ULc );
+	if ( area <= 0 )
+		throw (std::string)"Region has no pixels to average!";
+
+	areaSum( ULr, ULc, LRr, LRc, total );
+
+	for ( int k = 0; k < C; k++ )
+		out[k] = (int)floor( total[k] / area + 0.5 );
+
+	return result;
+}
+
+#endif
@@ -0,0 +1,151 @@
+#include <cmath>
+#include <string>
+#include "transform.h"
+
+using namespace std;
+
+/******************************************************************************\
+ default constructor, sets the matrix to the identity
+\******************************************************************************/
+Transform::Transform()
+{
+	for ( int i = 0; i < 3; i++ )
+		for ( int j = 0; j < 3; j++ )
+			m[i][j] = ( i == j ? 1 : 0 );
+}
+
+Transform::Transform( const double mat[3][3] )
+{
+	for ( int i = 0; i < 3; i++ )
+		for ( int j = 0; j < 3; j++ )
+			m[i][j] = mat[i][j];
+}
+
+Transform Transform::translate( double rows, double cols )
+{
+	Transform t;
+
+	t.m[0][2] = rows;
+	t.m[1][2] = cols;
+
+	return t;
+}
+
+Transform Transform::scale( double rows, double cols )
+{
+	Transform t;
+
+	t.m[0][0] = rows;
+	t.m[1][1] = cols;
+
+	return t;
+}
+
+/******************************************************************************\
+ a pixel at (r,c) ends up at
+   row = r_0 + (r-r_0)*cos - (c-c_0)*sin
+   col = c_0 + (r-r_0)*sin + (c-c_0)*cos
+ which is the inverse of the mapping rotateImage samples with
+\******************************************************************************/
+Transform Transform::rotate( double theta, double r_0, double c_0 )
+{
+	// exact values for 0, 90, 180 and 270 degrees
+	static const int quarterCos[4] = { 1, 0, -1, 0 };
+	static const int quarterSin[4] = { 0, 1, 0, -1 };
+
+	Transform t;
+	double cosT, sinT;
+	double angle = fmod( fmod( theta, 360.0 ) + 360.0, 360.0 );
+
+	if ( fmod( angle, 90.0 ) == 0 )
+	{
+		cosT = quarterCos[(int)angle / 90];
+		sinT = quarterSin[(int)angle / 90];
+	}
+	else
+	{
+		// 4 * atan(1) = pi
+		double rad = theta * 4 * atan(1.0)/180;
+		cosT = cos(rad);
+		sinT = sin(rad);
+	}
+
+	t.m[0][0] = cosT;
+	t.m[0][1] = -sinT;
+	t.m[0][2] = r_0 - r_0*cosT + c_0*sinT;
+	t.m[1][0] = sinT;
+	t.m[1][1] = cosT;
+	t.m[1][2] = c_0 - r_0*sinT - c_0*cosT;
+
+	return t;
+}
+
+Transform Transform::operator*( const Transform& rhs ) const
+{
+	Transform t;
+
+	for ( int i = 0; i < 3; i++ )
+		for ( int j = 0; j < 3; j++ )
+		{
+			t.m[i][j] = 0;
+			for ( int k = 0; k < 3; k++ )
+				t.m[i][j] += m[i][k] * rhs.m[k][j];
+		}
+
+	return t;
+}
+
+Transform Transform::then( const Transform& next ) const
+{
+	return next * *this;
+}
+
+/******************************************************************************\
+ the adjugate divided by the determinant.  Whole number matrices with a
+ determinant of 1 or -1 (rotations by 90 degrees, shifts by whole pixels)
+ come out exact
+\******************************************************************************/
+Transform Transform::inverse() const
+{
+	Transform t;
+	double det;
+
+	t.m[0][0] = m[1][1]*m[2][2] - m[1][2]*m[2][1];
+	t.m[0][1] = m[0][2]*m[2][1] - m[0][1]*m[2][2];
+	t.m[0][2] = m[0][1]*m[1][2] - m[0][2]*m[1][1];
+	t.m[1][0] = m[1][2]*m[2][0] - m[1][0]*m[2][2];
+	t.m[1][1] = m[0][0]*m[2][2] - m[0][2]*m[2][0];
+	t.m[1][2] = m[0][2]*m[1][0] - m[0][0]*m[1][2];
+	t.m[2][0] = m[1][0]*m[2][1] - m[1][1]*m[2][0];
+	t.m[2][1] = m[0][1]*m[2][0] - m[0][0]*m[2][1];
+	t.m[2][2] = m[0][0]*m[1][1] - m[0][1]*m[1][0];
+
+	det = m[0][0]*t.m[0][0] + m[0][1]*t.m[1][0] + m[0][2]*t.m[2][0];
+
+	if ( fabs( det ) < 1e-12 )
+		throw (string)"Transform can't be undone!";
+
+	for ( int i = 0; i < 3; i++ )
+		for ( int j = 0; j < 3; j++ )
+			t.m[i][j] /= det;
+
+	return t;
+}
+
+bool Transform::isAffine() const
+{
+	return m[2][0] == 0 && m[2][1] == 0 && m[2][2] == 1;
+}
+
+bool Transform::apply( double r, double c, double& row, double& col ) const
+{
+	double w = m[2][0]*r + m[2][1]*c + m[2][2];
+
+	if ( w <= 0 )
+		return false;
+
+	row = ( m[0][0]*r + m[0][1]*c + m[0][2] ) / w;
+	col = ( m[1][0]*r + m[1][1]*c + m[1][2] ) / w;
+
+	return true;
+}
@@ -0,0 +1,62 @@
+/******************************************************************************\
+ Transform is a 3x3 matrix that moves a pixel position (row, col) of a source
+ image to a position in the destination, as
+
+   [ row' ]   [ m00 m01 m02 ] [ row ]
+   [ col' ] = [ m10 m11 m12 ] [ col ]     row' = row'/w, col' = col'/w
+   [  w   ]   [ m20 m21 m22 ] [  1  ]
+
+ An affine transform (rotation, scaling, shifting and any mix of them) has a
+ bottom row of 0 0 1, anything else is a perspective transform.  Transforms
+ are combined by multiplying them, a.then( b ) is the transform that does a
+ and then b, so a whole chain of operations can be handed to
+ ImageType::warpAffine or warpPerspective and the image is only resampled
+ once.
+\******************************************************************************/
+
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+class Transform
+{
+public:
+// CONSTRUCTORS ////////////////////////////////////////////////////////////////
+	// default constructor, the identity (nothing moves)
+	Transform();
+
+	// parameterized constructor, copies the rows of a 3x3 matrix
+	Transform( const double[3][3] );
+
+	// shifts down by the first value and right by the second
+	static Transform translate( double, double );
+
+	// scales rows by the first value and columns by the second, about the
+	// top left corner
+	static Transform scale( double, double );
+
+	// rotates counter-clockwise by theta degrees about the row and col given,
+	// the same direction as ImageType::rotateImage.  Multiples of 90 degrees
+	// are exact
+	static Transform rotate( double, double, double );
+
+// OPERATORS ///////////////////////////////////////////////////////////////////
+	// the product of two matrices, a*b does b first and then a
+	Transform operator*( const Transform& ) const;
+
+	// does this transform and then the one passed
+	Transform then( const Transform& ) const;
+
+	// the transform that undoes this one, throws a string if there isn't one
+	Transform inverse() const;
+
+	// true if the bottom row is 0 0 1
+	bool isAffine() const;
+
+	// moves a row and col, the results are set to the last two parameters.
+	// Returns false if the point ends up at infinity (w <= 0)
+	bool apply( double, double, double&, double& ) const;
+
+	double m[3][3]; // the matrix, m[row][col]
+};
+
+#endif